@@ -0,0 +1,345 @@
+#include <iostream>
+#include <cstdio>
+#include <iomanip>
+#include <vector>
+#include <cstring>
+#include <string>
+#include <chrono>
+
+#include "data.h"
+#include "brkga.h"
+#include "held_karp.h"
+#ifdef BENCHMARK_GUROBI
+    #include "tsp_solver.h"
+#endif
+
+using namespace std;
+
+template < class Key >
+inline void benchmarkDecoder(const char* name, double seconds, Decoder::Encoding encoding = Decoder::LOADING_PLAN) {
+
+    Decoder decoder(1.0, 1.0, 1, 0, encoding);
+    MTRand rng(269070);
+
+    const int numChromosomes = 1000;
+    vector < vector < Key > > chromosomes(numChromosomes, vector < Key > (decoder.getChromosomeSize()));
+    for(int i = 0; i < numChromosomes; ++i) {
+        for(int j = 0; j < (int)chromosomes[i].size(); ++j) chromosomes[i][j] = KeyTraits < Key >::fromUnit(rng.rand());
+    }
+
+    // warm-up
+    double checksum = 0.0;
+    for(int i = 0; i < numChromosomes; ++i) checksum += decoder.decode(chromosomes[i]);
+
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    duration < double > time_span;
+    long long numDecodes = 0;
+
+    do {
+        for(int i = 0; i < numChromosomes; ++i) checksum += decoder.decode(chromosomes[i]);
+        numDecodes += numChromosomes;
+        time_span = duration_cast < duration < double > > (high_resolution_clock::now() - t1);
+    } while(time_span.count() < seconds);
+
+    char tmp[1000];
+    sprintf(tmp, "%-20s %15lld %15.3lf %15.0lf %20.0lf", name, numDecodes, time_span.count(), numDecodes / time_span.count(), checksum);
+    cout << tmp << endl;
+}
+
+// Same as benchmarkDecoder, but the chromosomes of a population of runBRKGA's size, after a few
+// generations, are decoded through Decoder::decodeBatch in blocks as BRKGA::evolution does; with a
+// cache, every pass after the first finds the population in it, as far as it fits
+inline void benchmarkBatchDecoder(const char* name, double seconds, int blockSize, unsigned long cacheSize = 0) {
+
+    Decoder decoder(1.0, 1.0, 1, cacheSize);
+    MTRand rng(269070);
+    const unsigned n = decoder.getChromosomeSize();
+    BRKGA < Decoder, MTRand > algorithm(n, n * 200, 0.10, 0.25, 0.70, decoder, rng, 1, 1);
+    algorithm.evolve(20);
+
+    const Population < double >& population = algorithm.getPopulation();
+    const int numChromosomes = population.getP();
+    vector < vector < Span < const double > > > blocks((numChromosomes + blockSize - 1) / blockSize);
+    for(int i = 0; i < numChromosomes; ++i) blocks[i / blockSize].push_back(population.getChromosome(i));
+
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    duration < double > time_span;
+    long long numDecodes = 0;
+    double checksum = 0.0;
+    vector < double > fitness;
+
+    do {
+        for(int b = 0; b < (int)blocks.size(); ++b) {
+            if(blockSize > 1) decoder.decodeBatch(blocks[b], fitness);
+            else fitness.assign(1, decoder.decode(blocks[b][0]));
+            for(int i = 0; i < (int)fitness.size(); ++i) checksum += fitness[i];
+        }
+        numDecodes += numChromosomes;
+        time_span = duration_cast < duration < double > > (high_resolution_clock::now() - t1);
+    } while(time_span.count() < seconds);
+
+    char tmp[1000];
+    sprintf(tmp, "%-20s %15lld %15.3lf %15.0lf %20.0lf", name, numDecodes, time_span.count(), numDecodes / time_span.count(), checksum);
+    cout << tmp << endl;
+}
+
+// Random keys per second, drawn in blocks of one chromosome as BRKGA::evolution does
+template < class RNG >
+inline void benchmarkRNG(const char* name, double seconds) {
+
+    RNG rng(269070);
+    vector < double > block(Decoder().getChromosomeSize());
+
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    duration < double > time_span;
+    long long numDeviates = 0;
+    double checksum = 0.0;
+
+    do {
+        for(int i = 0; i < 1000; ++i) {
+            rng.fill(block.data(), block.size());
+            checksum += block[0];
+        }
+        numDeviates += 1000 * (long long)block.size();
+        time_span = duration_cast < duration < double > > (high_resolution_clock::now() - t1);
+    } while(time_span.count() < seconds);
+
+    char tmp[1000];
+    sprintf(tmp, "%-20s %15lld %15.3lf %15.0lf %20.3lf", name, numDeviates, time_span.count(), numDeviates / time_span.count(), checksum);
+    cout << tmp << endl;
+}
+
+// Exact TSPs per second on the combined pickup + delivery matrix, as solved by computeLowerBound
+template < class Solver >
+inline void benchmarkTSP(const char* name, double seconds, Solver& solver) {
+
+    const int numNodes = Data::getInstance().numItems + 1;
+    vector < vector < int > > distance(numNodes, vector < int > (numNodes));
+    for(int i = 0; i < numNodes; ++i) {
+        for(int j = 0; j < numNodes; ++j) {
+            distance[i][j] = Data::getInstance().pickupDistance[i][j] + Data::getInstance().deliveryDistance[i][j];
+        }
+    }
+
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    duration < double > time_span;
+    long long numSolves = 0;
+    double checksum = 0.0;
+
+    do {
+        checksum += solver.solve(numNodes, distance).first;
+        numSolves += 1;
+        time_span = duration_cast < duration < double > > (high_resolution_clock::now() - t1);
+    } while(time_span.count() < seconds);
+
+    char tmp[1000];
+    sprintf(tmp, "%-20s %15lld %15.3lf %15.3lf %20.0lf", name, numSolves, time_span.count(), numSolves / time_span.count(), checksum);
+    cout << tmp << endl;
+}
+
+// Decoder that does no work, to measure the BRKGA framework alone
+struct NullDecoder {
+    template < class Chromosome >
+    double decode(const Chromosome& chromosome, unsigned = 0, double = INF) {
+        return KeyTraits < typename Chromosome::value_type >::toUnit(chromosome[0]);
+    }
+
+    template < class Key >
+    void decodeBatch(const vector < Span < const Key > >& block, vector < double >& fitness, unsigned threadId = 0, double cutoff = INF) {
+        fitness.resize(block.size());
+        for(int i = 0; i < (int)block.size(); ++i) fitness[i] = decode(block[i], threadId, cutoff);
+    }
+};
+
+// Generations per second of the framework (offspring, mutants, elite survival and ranking) on a
+// population of the size runBRKGA uses for chromosomes of the given encoding
+inline void benchmarkGeneration(const char* name, double seconds, int numThreads, Decoder::Encoding encoding = Decoder::LOADING_PLAN) {
+
+    NullDecoder decoder;
+    MTRand rng(269070);
+    const unsigned n = Decoder(1.0, 1.0, 1, 0, encoding).getChromosomeSize();
+    BRKGA < NullDecoder, MTRand > algorithm(n, n * 200, 0.10, 0.25, 0.70, decoder, rng, 1, numThreads);
+
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    duration < double > time_span;
+    long long numGenerations = 0;
+
+    do {
+        algorithm.evolve();
+        numGenerations += 1;
+        time_span = duration_cast < duration < double > > (high_resolution_clock::now() - t1);
+    } while(time_span.count() < seconds);
+
+    char tmp[1000];
+    sprintf(tmp, "%-20s %15lld %15.3lf %15.3lf %20.6lf", name, numGenerations, time_span.count(), numGenerations / time_span.count(), algorithm.getBestFitness());
+    cout << tmp << endl;
+}
+
+// Rankings per second of the fitness of a population of runBRKGA's size: of the elite alone, as after
+// each BRKGA generation, or of all of it. A full sort of integral fitness, like the costs of the
+// decoder, is a radix sort on packed 64-bit keys, and of fractional fitness a std::sort
+struct RankingBenchmark {
+    static void run(const char* name, double seconds, bool full, bool integral) {
+
+        const unsigned n = Decoder().getChromosomeSize();
+        const unsigned p = n * 200;
+        const unsigned pe = unsigned(0.10 * p);
+        Population < double > population(n, p);
+
+        MTRand rng(269070);
+        vector < double > fitness(p);
+        for(unsigned i = 0; i < p; ++i) fitness[i] = integral ? std::floor(rng.rand() * 1000000.0) : rng.rand();
+
+        using namespace std::chrono;
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+        duration < double > time_span;
+        long long numRankings = 0;
+        double checksum = 0.0;
+
+        do {
+            for(int i = 0; i < 10; ++i) {
+                for(unsigned j = 0; j < p; ++j) population.setFitness(j, fitness[j]);
+                if(full) population.sortFitness();
+                else population.rankFitness(pe);
+                checksum += population.getFitness(pe - 1);
+            }
+            numRankings += 10;
+            time_span = duration_cast < duration < double > > (high_resolution_clock::now() - t1);
+        } while(time_span.count() < seconds);
+
+        char tmp[1000];
+        sprintf(tmp, "%-20s %15lld %15.3lf %15.3lf %20.6lf", name, numRankings, time_span.count(), numRankings / time_span.count(), checksum);
+        cout << tmp << endl;
+    }
+};
+
+// Archive insertions per second, one population of (distance, relocations) points at a time into an
+// empty archive; mode 0 adds them one by one, mode 1 as a batch and mode 2 from all threads at once
+inline void benchmarkArchive(const char* name, double seconds, int mode, int numThreads) {
+
+    // points spread around a trade-off line, so that most are dominated as in a real run
+    MTRand rng(269070);
+    const int numItems = Data::getInstance().numItems;
+    const int populationSize = 1000;
+    vector < pair < int, int > > points(populationSize);
+    for(int i = 0; i < populationSize; ++i) {
+        int relocations = rng.randInt(2 * numItems);
+        points[i] = make_pair(1000 * numItems - 200 * relocations + rng.randInt(400 * numItems), relocations);
+    }
+
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    duration < double > time_span;
+    long long numInsertions = 0;
+    double checksum = 0.0;
+
+    do {
+        for(int i = 0; i < 100; ++i) {
+            if(mode == 2) {
+                ConcurrentNonDominatedSet archive;
+                #ifdef _OPENMP
+                    #pragma omp parallel num_threads(numThreads)
+                #endif
+                {
+                    ConcurrentNonDominatedSet::Handle handle(archive);
+                    #ifdef _OPENMP
+                        #pragma omp for schedule(static)
+                    #endif
+                    for(int j = 0; j < populationSize; ++j) handle.add(points[j]);
+                }
+                checksum += archive.getSet().size();
+            } else {
+                NonDominatedSet archive;
+                if(mode == 1) archive.add(points);
+                else for(int j = 0; j < populationSize; ++j) archive.add(points[j]);
+                checksum += archive.size();
+            }
+        }
+        numInsertions += 100 * populationSize;
+        time_span = duration_cast < duration < double > > (high_resolution_clock::now() - t1);
+    } while(time_span.count() < seconds);
+
+    char tmp[1000];
+    sprintf(tmp, "%-20s %15lld %15.3lf %15.0lf %20.0lf", name, numInsertions, time_span.count(), numInsertions / time_span.count(), checksum);
+    cout << tmp << endl;
+}
+
+#ifdef BENCHMARK_GUROBI
+struct GurobiTSP {
+    pair < int, vector < int > > solve(int n, const vector < vector < int > > &distance) {
+        return TSPSolver().solveWithGurobi(n, distance);
+    }
+};
+#endif
+
+inline void usage() {
+    clog << "\n       Usage ./benchmark --pickuparea <pickup_area_file_name> --deliveryarea <delivery_area_file_name> --n <number_of_items> --l <reloading_depth> --h <relocation_cost> [--seconds <time_per_benchmark>] [--threads <number_of_threads>] " << endl;
+    exit(0);
+}
+
+int main(int argc, char **argv) {
+
+    if(argc < 11) usage();
+
+    int numItems, reloadingDepth, costForEachRelocate;
+    double seconds = 10.0;
+    int numThreads = 1;
+    char parameterStr[1000];
+    string pickupAreaFileName, deliveryAreaFileName;
+
+    int check_parameters = 0;
+    for(int i = 1; i < argc; i += 2) {
+        if(strcmp(argv[i], "--pickuparea") == 0) { sscanf(argv[i+1],"%s", parameterStr); pickupAreaFileName = parameterStr; check_parameters += 1; }
+        else if(strcmp(argv[i], "--deliveryarea") == 0) { sscanf(argv[i+1],"%s", parameterStr); deliveryAreaFileName = parameterStr; check_parameters += 1; }
+        else if(strcmp(argv[i], "--n") == 0) { sscanf(argv[i+1],"%d", &numItems); check_parameters += 1; }
+        else if(strcmp(argv[i], "--l") == 0) { sscanf(argv[i+1],"%d", &reloadingDepth); check_parameters += 1; }
+        else if(strcmp(argv[i], "--h") == 0) { sscanf(argv[i+1],"%d", &costForEachRelocate); check_parameters += 1; }
+        else if(strcmp(argv[i], "--seconds") == 0) { sscanf(argv[i+1],"%lf", &seconds); }
+        else if(strcmp(argv[i], "--threads") == 0) { sscanf(argv[i+1],"%d", &numThreads); }
+        else check_parameters = -INF;
+    }
+
+    if(check_parameters != 5) usage();
+
+    Data::getInstance().readData(pickupAreaFileName, deliveryAreaFileName, numItems, reloadingDepth, costForEachRelocate);
+
+    char tmp[1000];
+    sprintf(tmp, "%-20s %15s %15s %15s %20s", "benchmark", "count", "time(s)", "rate/s", "checksum");
+    cout << tmp << endl;
+
+    benchmarkDecoder < double > ("decoder", seconds);
+    benchmarkDecoder < float > ("decoder-float", seconds);
+    benchmarkDecoder < FixedKey16 > ("decoder-fixed16", seconds);
+    benchmarkDecoder < double > ("decoder-tours", seconds, Decoder::TOURS);
+    benchmarkBatchDecoder("decoder-population", seconds, 1);
+    benchmarkBatchDecoder("decoder-batch", seconds, 128);
+    benchmarkBatchDecoder("decoder-pop-cache", seconds, 1, 1 << 16);
+    benchmarkBatchDecoder("decoder-batch-cache", seconds, 128, 1 << 16);
+    benchmarkRNG < MTRand > ("rng-mtrand", seconds);
+    benchmarkRNG < PhiloxRNG > ("rng-philox", seconds);
+    benchmarkGeneration("brkga-generation", seconds, numThreads);
+    benchmarkGeneration("brkga-generation-tours", seconds, numThreads, Decoder::TOURS);
+    RankingBenchmark::run("rank-elite", seconds, false, false);
+    RankingBenchmark::run("rank-elite-int", seconds, false, true);
+    RankingBenchmark::run("sort-population", seconds, true, false);
+    RankingBenchmark::run("sort-population-int", seconds, true, true);
+    benchmarkArchive("nds-insert", seconds, 0, numThreads);
+    benchmarkArchive("nds-batch", seconds, 1, numThreads);
+    benchmarkArchive("nds-concurrent", seconds, 2, numThreads);
+
+    if(numItems + 1 <= HeldKarpSolver::MAX_NODES) {
+        HeldKarpSolver heldKarp(numThreads);
+        benchmarkTSP("tsp-held-karp", seconds, heldKarp);
+    }
+    #ifdef BENCHMARK_GUROBI
+        GurobiTSP gurobi;
+        benchmarkTSP("tsp-gurobi", seconds, gurobi);
+    #endif
+
+    return 0;
+}
@@ -1,206 +1,1214 @@
 #include <iomanip>
 #include <fstream>
+#include <functional>
+#include <limits>
 
 #include "brkga.h"
 
-Decoder::Decoder(double _alpha, double _beta) {
+// Sorting networks for up to 6 elements, used on the small key groups of shallow reloading depths
+
+template< class T >
+inline void compareExchange(T& a, T& b) {
+    if(b < a) swap(a, b);
+}
+
+template< int M > struct SortingNetwork;
+
+template<> struct SortingNetwork< 1 > {
+    template< class T > static void sort(T*) {}
+};
+
+template<> struct SortingNetwork< 2 > {
+    template< class T > static void sort(T* a) {
+        compareExchange(a[0], a[1]);
+    }
+};
+
+template<> struct SortingNetwork< 3 > {
+    template< class T > static void sort(T* a) {
+        compareExchange(a[0], a[2]); compareExchange(a[0], a[1]); compareExchange(a[1], a[2]);
+    }
+};
+
+template<> struct SortingNetwork< 4 > {
+    template< class T > static void sort(T* a) {
+        compareExchange(a[0], a[1]); compareExchange(a[2], a[3]);
+        compareExchange(a[0], a[2]); compareExchange(a[1], a[3]);
+        compareExchange(a[1], a[2]);
+    }
+};
+
+template<> struct SortingNetwork< 5 > {
+    template< class T > static void sort(T* a) {
+        compareExchange(a[0], a[1]); compareExchange(a[3], a[4]);
+        compareExchange(a[2], a[4]); compareExchange(a[2], a[3]);
+        compareExchange(a[0], a[3]); compareExchange(a[0], a[2]);
+        compareExchange(a[1], a[4]); compareExchange(a[1], a[3]);
+        compareExchange(a[1], a[2]);
+    }
+};
+
+template<> struct SortingNetwork< 6 > {
+    template< class T > static void sort(T* a) {
+        compareExchange(a[1], a[2]); compareExchange(a[4], a[5]);
+        compareExchange(a[0], a[2]); compareExchange(a[3], a[5]);
+        compareExchange(a[0], a[1]); compareExchange(a[3], a[4]);
+        compareExchange(a[2], a[5]); compareExchange(a[0], a[3]);
+        compareExchange(a[1], a[4]); compareExchange(a[2], a[4]);
+        compareExchange(a[1], a[3]); compareExchange(a[2], a[3]);
+    }
+};
+
+// Change in the length of a tour, depot at both ends, when its stops at positions a and b trade places
+inline int tourSwapDelta(const vector < int >& tour, int a, int b, const vector < vector < int > >& d) {
+    if(a > b) swap(a, b);
+    const int u = tour[a], v = tour[b];
+    if(b == a + 1) {
+        return d[tour[a-1]][v] + d[v][u] + d[u][tour[b+1]] - d[tour[a-1]][u] - d[u][v] - d[v][tour[b+1]];
+    }
+    return d[tour[a-1]][v] + d[v][tour[a+1]] + d[tour[b-1]][u] + d[u][tour[b+1]]
+         - d[tour[a-1]][u] - d[u][tour[a+1]] - d[tour[b-1]][v] - d[v][tour[b+1]];
+}
+
+// Relocations of a rearrangement whose i-th input goes to rank[i], once inputs a and b trade ranks
+inline int relocationsAfterSwap(const pair < double, int >* rank, int size, int a, int b) {
+    for(int i = 0; i < size; ++i) {
+        const int r = (i == a) ? rank[b].second : (i == b) ? rank[a].second : rank[i].second;
+        if(r != i) return size - i - 1;
+    }
+    return 0;
+}
+
+// Whether the i-th key of a sorted group equals another one. Swapping two untied keys swaps exactly
+// their ranks; a tied key would land on the other side of its twin, as ties are broken by index.
+inline bool isTied(const pair < double, int >* sorted, int size, int i) {
+    return (i > 0 && sorted[i-1].first == sorted[i].first) || (i + 1 < size && sorted[i+1].first == sorted[i].first);
+}
+
+Decoder::Decoder(double _alpha, double _beta, unsigned _numThreads, unsigned long cacheCapacity, Encoding _encoding, unsigned _beamWidth) : cache(cacheCapacity) {
+
     alpha = _alpha;
     beta = _beta;
+
+    n = Data::getInstance().numItems;
+    l = Data::getInstance().reloadingDepth;
+    relocationCost = Data::getInstance().costForEachRealoading;
+    encoding = _encoding;
+    beamWidth = _beamWidth;
+
+    depth = min(l, n - 1);
+    if(depth > MAX_FIXED_DEPTH || encoding == TOURS) depth = GENERIC_DEPTH;
+
+    // group 0 holds the n pickup keys, groups 1..n the rearrangements made at each
+    // pickup and groups n+1..2n the rearrangements made at each delivery. With TOURS,
+    // group 1 holds the n delivery keys instead.
+    groupOffset.push_back(0);
+    groupOffset.push_back(n);
+    if(encoding == TOURS) groupOffset.push_back(2 * n);
+    for(int k = 1; k <= n && encoding == LOADING_PLAN; ++k) {
+        groupOffset.push_back(groupOffset.back() + min(k, l + 1));
+    }
+    for(int k = 1; k <= n && encoding == LOADING_PLAN; ++k) {
+        groupOffset.push_back(groupOffset.back() + min(n - k + 1, l + 1));
+    }
+
+    // in the steps of decodeBatch(), each pickup step is its item and then its ranks
+    if(encoding == LOADING_PLAN) {
+        stepStart.assign(2 * n + 2, 0);
+        for(int k = 1; k <= n + n; ++k) stepStart[k] = (k <= n) ? groupOffset[k] - n + k - 1 : groupOffset[k];
+        stepStart[2 * n + 1] = groupOffset.back();
+    }
+
+    workspaces.resize(max(1u, _numThreads));
+    for(int t = 0; t < (int)workspaces.size(); ++t) {
+        workspaces[t].keys.resize(groupOffset.back());
+        workspaces[t].window.reserve(l + 1);
+        workspaces[t].stack.reserve(n);
+        workspaces[t].pickupTour.resize(n + 2);
+        workspaces[t].deliveryTour.resize(n + 2);
+        workspaces[t].stepItems.resize(groupOffset.back());
+        workspaces[t].deliveryPosition.resize(n + 1);
+        workspaces[t].undo.resize(groupOffset.back());
+        workspaces[t].stepTop.resize(2 * n + 1);
+        workspaces[t].stepRelocations.resize(2 * n + 1);
+        workspaces[t].stepDistance.resize(2 * n + 1);
+        workspaces[t].stepLast.resize(2 * n + 1);
+        workspaces[t].pickupPositions.resize(n + 1);
+        workspaces[t].tourWindow.resize(n + 1);
+        workspaces[t].tourSorted.resize(n + 1);
+        workspaces[t].rollout.resize(n);
+        workspaces[t].keyOrder.resize(n);
+        workspaces[t].cacheLookups = 0;
+        workspaces[t].cacheHits = 0;
+    }
 }
-        
+
 Decoder::~Decoder() {}
 
-double Decoder::decode(const std::vector< double >& chromosome, string solutionFileOut) {
+int Decoder::getChromosomeSize() const {
+    return groupOffset.back();
+}
 
-    int n = Data::getInstance().numItems;
-    int l = Data::getInstance().reloadingDepth;
+void Decoder::setRelocationCost(int h) {
+    // the plan that the beam builds for a tour depends on h, so the cached ones are stale
+    if(encoding == TOURS && h != relocationCost) cache.clear();
+    relocationCost = h;
+}
 
-    vector < vector < pair < double, int > > > permutations;
+int Decoder::getRelocationCost() const {
+    return relocationCost;
+}
 
-    int id = 0;
-    
-    permutations.push_back(vector < pair < double, int > > ());
-    for(int i = 0; i < n; ++i) {
-        permutations.back().push_back(make_pair(chromosome[id], i+1));
-        id += 1;
+void Decoder::trackRelocationCosts(const vector < int >& costs) {
+
+    trackedCosts = costs;
+    incumbentCost.assign(costs.size(), INF);
+    incumbentKeys.assign(costs.size(), vector < double > ());
+    for(int t = 0; t < (int)workspaces.size(); ++t) {
+        workspaces[t].incumbentCost.assign(costs.size(), INF);
+        workspaces[t].incumbentKeys.assign(costs.size(), vector < double > ());
     }
-    
-    for(int k = 1; k <= n; ++k) {
-        permutations.push_back(vector < pair < double, int > > ());
-        for(int i = 0; i < min(k, l + 1); ++i) {
-            permutations.back().push_back(make_pair(chromosome[id], i));
-            id += 1;
+}
+
+template< class Key >
+void Decoder::updateIncumbents(Span< const Key > chromosome, Workspace& ws, int distance, int numberOfRelocations) {
+
+    // ties are broken by the keys, so the incumbents do not depend on the decoding order
+    vector < double >& keys = ws.unitKeys;
+    bool converted = false;
+    for(int i = 0; i < (int)trackedCosts.size(); ++i) {
+        int cost = alpha * distance + beta * trackedCosts[i] * numberOfRelocations;
+        if(cost > ws.incumbentCost[i]) continue;
+        if(!converted) {
+            keys.resize(chromosome.size());
+            for(int j = 0; j < (int)chromosome.size(); ++j) keys[j] = KeyTraits< Key >::toUnit(chromosome[j]);
+            converted = true;
+        }
+        if(cost < ws.incumbentCost[i] || keys < ws.incumbentKeys[i]) {
+            ws.incumbentCost[i] = cost;
+            ws.incumbentKeys[i] = keys;
         }
     }
-    
-    for(int k = 1; k <= n; ++k) {
-        permutations.push_back(vector < pair < double, int > > ());
-        for(int i = 0; i < min(n - k + 1, l + 1); ++i) {
-            permutations.back().push_back(make_pair(chromosome[id], i));
-            id += 1;
+}
+
+template< class Key, int Depth >
+void Decoder::sortGroup(Span< const Key > chromosome, Workspace& ws, int g) {
+
+    if(Depth == GENERIC_DEPTH || g == 0) {
+        for(int id = groupOffset[g]; id < groupOffset[g+1]; ++id) {
+            ws.keys[id] = make_pair(KeyTraits< Key >::toUnit(chromosome[id]), id - groupOffset[g]);
         }
+        sort(ws.keys.begin() + groupOffset[g], ws.keys.begin() + groupOffset[g+1]);
+        return;
     }
-    
-    for(int i = 0; i < (int)permutations.size(); ++i) {
-        sort(permutations[i].begin(), permutations[i].end());
+
+    // groups shorter than Depth + 1 are padded with keys that sort after every real one
+    const int width = Depth < 0 ? 1 : Depth + 1;
+    const int size = groupOffset[g+1] - groupOffset[g];
+    pair < double, int > group[width];
+    for(int i = 0; i < width; ++i) {
+        group[i] = make_pair(i < size ? KeyTraits< Key >::toUnit(chromosome[groupOffset[g] + i]) : numeric_limits < double > ::infinity(), i);
     }
+    SortingNetwork< width >::sort(group);
+    copy(group, group + size, ws.keys.begin() + groupOffset[g]);
+}
+
+// Sorts every group and returns a hash of the resulting ranks, which alone determine the solution
+template< class Key, int Depth >
+uint64_t Decoder::sortAllGroups(Span< const Key > chromosome, Workspace& ws) {
+
+    uint64_t hash = 14695981039346656037ULL;
+    for(int g = 0; g + 1 < (int)groupOffset.size(); ++g) {
+        sortGroup< Key, Depth >(chromosome, ws, g);
+        for(int id = groupOffset[g]; id < groupOffset[g+1]; ++id) {
+            hash = (hash ^ (uint64_t)ws.keys[id].second) * 1099511628211ULL;
+        }
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+template< class Key >
+bool Decoder::evaluate(Span< const Key > chromosome, Workspace& ws, int& distance, int& numberOfRelocations, double cutoff, vector < vector < int > >* timeline, bool groupsSorted) {
+
+    vector < pair < double, int > >& keys = ws.keys;
+    vector < pair < int, int > >& vt = ws.window;
+    vector < int >& stack = ws.stack;
+    vector < int >& pickupTour = ws.pickupTour;
+    vector < int >& deliveryTour = ws.deliveryTour;
     
-    vector < int > pickupTour;
-    vector < int > deliveryTour;
-    vector < int > stack;
-    int numberOfRelocations = 0;
-    int distance = 0;
-    
-    pickupTour.push_back(0);
+    const double relocationWeight = beta * relocationCost;
+
+    stack.clear();
+    numberOfRelocations = 0;
+    distance = 0;
+
+    if(!groupsSorted) sortGroup< Key, GENERIC_DEPTH >(chromosome, ws, 0);
+
+    pickupTour[0] = 0;
     for(int i = 0; i < n; ++i) {
-        pickupTour.push_back(permutations[0][i].second);
+        pickupTour[i+1] = keys[i].second + 1;
+    }
+    pickupTour[n+1] = 0;
+
+    for(int i = 1; i < n + 2; ++i) {
+        distance += Data::getInstance().pickupDistance[pickupTour[i-1]][pickupTour[i]];
     }
-    pickupTour.push_back(0);
     
+    // the remaining groups are only sorted once the partial cost is still below the cutoff
+    if(alpha * distance > cutoff) return false;
+
     for(int k = 1; k <= n; ++k) {
-        
-        vector < pair < int, int > > vt;
-        
-        vt.push_back(make_pair(permutations[k][0].second, pickupTour[k]));            
-        for(int i = 1; i < (int) permutations[k].size(); ++i) {
-            vt.push_back(make_pair(permutations[k][i].second, stack.back()));
-            stack.erase(--stack.end());
+
+        if(!groupsSorted) sortGroup< Key, GENERIC_DEPTH >(chromosome, ws, k);
+
+        const pair < double, int >* group = &keys[groupOffset[k]];
+        const int groupSize = groupOffset[k+1] - groupOffset[k];
+
+        vt.clear();
+        vt.push_back(make_pair(group[0].second, pickupTour[k]));
+        for(int i = 1; i < groupSize; ++i) {
+            vt.push_back(make_pair(group[i].second, stack.back()));
+            stack.pop_back();
         }
-        
+
         for(int i = 0; i < (int)vt.size(); ++i) {
             if(vt[i].first != i) {
                 numberOfRelocations += (int)vt.size() - i - 1;
                 break;
             }
         }
-        
+
         sort(vt.rbegin(), vt.rend());
         for(int i = 0; i < (int)vt.size(); ++i) {
             stack.push_back(vt[i].second);
         }
+
+        if(timeline != NULL) timeline->push_back(stack);
+        
+        if(alpha * distance + relocationWeight * numberOfRelocations > cutoff) return false;
     }
-    
-    deliveryTour.push_back(0);
-    
+
+    deliveryTour[0] = 0;
+
     for(int k = n+1; k <= n+n; ++k) {
-    
-        vector < pair < int, int > > vt;
-        
-        for(int i = 0; i < (int) permutations[k].size(); ++i) {
-            vt.push_back(make_pair(permutations[k][i].second, stack.back()));
-            stack.erase(--stack.end());
+
+        if(!groupsSorted) sortGroup< Key, GENERIC_DEPTH >(chromosome, ws, k);
+
+        const pair < double, int >* group = &keys[groupOffset[k]];
+        const int groupSize = groupOffset[k+1] - groupOffset[k];
+
+        if(timeline != NULL) timeline->push_back(stack);
+
+        vt.clear();
+        for(int i = 0; i < groupSize; ++i) {
+            vt.push_back(make_pair(group[i].second, stack.back()));
+            stack.pop_back();
         }
-        
+
         for(int i = 0; i < (int)vt.size(); ++i) {
             if(vt[i].first != i) {
                 numberOfRelocations += (int)vt.size() - i - 1;
                 break;
             }
         }
-        
+
         sort(vt.rbegin(), vt.rend());
         for(int i = 0; i < (int)vt.size(); ++i) {
-            stack.push_back(vt[i].second);            
+            stack.push_back(vt[i].second);
         }
+
+        deliveryTour[k-n] = stack.back();
+        distance += Data::getInstance().deliveryDistance[deliveryTour[k-n-1]][deliveryTour[k-n]];
+
+        stack.pop_back();
         
-        deliveryTour.push_back(stack.back());
-        
-        stack.erase(--stack.end());
+        if(alpha * distance + relocationWeight * numberOfRelocations > cutoff) return false;
     }
-    deliveryTour.push_back(0);
-    
+    deliveryTour[n+1] = 0;
+    distance += Data::getInstance().deliveryDistance[deliveryTour[n]][deliveryTour[n+1]];
+
+    return alpha * distance + relocationWeight * numberOfRelocations <= cutoff;
+}
+
+// Same as evaluate(), for groups of at most Depth + 1 keys: the window of the stack rearranged at a
+// step is moved into a fixed-size buffer and written back by rank, without building or sorting pairs
+template< class Key, int Depth >
+bool Decoder::evaluateFixed(Span< const Key > chromosome, Workspace& ws, int& distance, int& numberOfRelocations, double cutoff, vector < vector < int > >* timeline, bool groupsSorted) {
+
+    const int width = Depth < 0 ? 1 : Depth + 1;
+    vector < pair < double, int > >& keys = ws.keys;
+    vector < int >& pickupTour = ws.pickupTour;
+    vector < int >& deliveryTour = ws.deliveryTour;
+
+    const double relocationWeight = beta * relocationCost;
+
+    ws.stack.resize(n);
+    int* stack = ws.stack.data();
+    int top = 0;    // number of items in the container
+    int window[width];
+
+    numberOfRelocations = 0;
     distance = 0;
-    for(int i = 1; i < (int)pickupTour.size(); ++i) {
+
+    if(!groupsSorted) sortGroup< Key, Depth >(chromosome, ws, 0);
+
+    pickupTour[0] = 0;
+    for(int i = 0; i < n; ++i) {
+        pickupTour[i+1] = keys[i].second + 1;
+    }
+    pickupTour[n+1] = 0;
+
+    for(int i = 1; i < n + 2; ++i) {
         distance += Data::getInstance().pickupDistance[pickupTour[i-1]][pickupTour[i]];
     }
-    for(int i = 1; i < (int)deliveryTour.size(); ++i) {
-        distance += Data::getInstance().deliveryDistance[deliveryTour[i-1]][deliveryTour[i]];
+
+    if(alpha * distance > cutoff) return false;
+
+    for(int k = 1; k <= n; ++k) {
+
+        if(!groupsSorted) sortGroup< Key, Depth >(chromosome, ws, k);
+
+        const pair < double, int >* group = &keys[groupOffset[k]];
+        const int groupSize = groupOffset[k+1] - groupOffset[k];
+
+        // the picked up item, then the ones taken off the top of the container
+        window[0] = pickupTour[k];
+        for(int i = 1; i < groupSize; ++i) window[i] = stack[top - i];
+
+        for(int i = 0; i < groupSize; ++i) {
+            if(group[i].second != i) {
+                numberOfRelocations += groupSize - i - 1;
+                break;
+            }
+        }
+
+        // the item matched with the smallest key index ends on top
+        const int base = top - (groupSize - 1);
+        for(int i = 0; i < groupSize; ++i) stack[base + groupSize - 1 - group[i].second] = window[i];
+        top = base + groupSize;
+
+        if(timeline != NULL) timeline->push_back(vector < int > (stack, stack + top));
+
+        if(alpha * distance + relocationWeight * numberOfRelocations > cutoff) return false;
     }
-        
-    int totalCost = alpha * distance + beta * Data::getInstance().costForEachRealoading * numberOfRelocations;
-    
-    if(solutionFileOut != "") {
-            
-        vector < vector < int > > container;
-        stack.clear();
-    
-        for(int k = 1; k <= n; ++k) {
-            
-            vector < pair < int, int > > vt;
-            
-            vt.push_back(make_pair(permutations[k][0].second, pickupTour[k]));            
-            for(int i = 1; i < (int) permutations[k].size(); ++i) {
-                vt.push_back(make_pair(permutations[k][i].second, stack.back()));
-                stack.erase(--stack.end());
-            }
-            
-            sort(vt.rbegin(), vt.rend());
-            for(int i = 0; i < (int)vt.size(); ++i) {
-                stack.push_back(vt[i].second);
-            }
-            container.push_back(stack);
+
+    deliveryTour[0] = 0;
+
+    for(int k = n+1; k <= n+n; ++k) {
+
+        if(!groupsSorted) sortGroup< Key, Depth >(chromosome, ws, k);
+
+        const pair < double, int >* group = &keys[groupOffset[k]];
+        const int groupSize = groupOffset[k+1] - groupOffset[k];
+
+        if(timeline != NULL) timeline->push_back(vector < int > (stack, stack + top));
+
+        for(int i = 0; i < groupSize; ++i) window[i] = stack[top - 1 - i];
+
+        for(int i = 0; i < groupSize; ++i) {
+            if(group[i].second != i) {
+                numberOfRelocations += groupSize - i - 1;
+                break;
+            }
         }
-        
-        container.push_back(stack);
-
-        for(int k = n+1; k <= n+n; ++k) {
-            
-            vector < pair < int, int > > vt;
-            
-            for(int i = 0; i < (int) permutations[k].size(); ++i) {
-                vt.push_back(make_pair(permutations[k][i].second, stack.back()));
-                stack.erase(--stack.end());
-            }
-            
-            sort(vt.rbegin(), vt.rend());
-            for(int i = 0; i < (int)vt.size(); ++i) {
-                stack.push_back(vt[i].second);            
-            }
-            
-            stack.erase(--stack.end());
-            
-            container.push_back(stack);
+
+        const int base = top - groupSize;
+        for(int i = 0; i < groupSize; ++i) stack[base + groupSize - 1 - group[i].second] = window[i];
+
+        deliveryTour[k-n] = stack[top - 1];
+        distance += Data::getInstance().deliveryDistance[deliveryTour[k-n-1]][deliveryTour[k-n]];
+
+        top -= 1;
+
+        if(alpha * distance + relocationWeight * numberOfRelocations > cutoff) return false;
+    }
+    deliveryTour[n+1] = 0;
+    distance += Data::getInstance().deliveryDistance[deliveryTour[n]][deliveryTour[n+1]];
+
+    return alpha * distance + relocationWeight * numberOfRelocations <= cutoff;
+}
+
+template< class Key >
+bool Decoder::evaluateTours(Span< const Key > chromosome, Workspace& ws, int& distance, int& numberOfRelocations, double cutoff, vector < vector < int > >* timeline, bool groupsSorted) {
+
+    if(!groupsSorted) {
+        sortGroup< Key, GENERIC_DEPTH >(chromosome, ws, 0);
+        sortGroup< Key, GENERIC_DEPTH >(chromosome, ws, 1);
+    }
+    return planTours(ws, distance, numberOfRelocations, cutoff, timeline);
+}
+
+// Loading plan of a TOURS chromosome, whose groups 0 and 1 are sorted in ws.keys. The container
+// holds the positions of its items in the delivery tour, and a step either leaves its window as it
+// is or sorts the bottom part of it from some entry on, smallest position on top, at the cost that
+// evaluate() counts for it. When the delivery tour can be followed, some plan made of such steps
+// is optimal (checked against every rearrangement on small instances). A delivery takes the
+// smallest position of the window, so when the next one of the tour is out of reach, the plan
+// leaves the tour (a deviation) instead of failing; plans are compared by deviations first, and
+// then by cost. The states of each step are those of a dynamic program, merged when they have the
+// same container and last delivery. Beyond beamWidth of them, the ones of lowest cost once
+// completed by completeGreedily() are kept: the search is exact until then, and bounded after.
+// The plan itself is replayed into pickupTour, deliveryTour and timeline only if timeline is given.
+bool Decoder::planTours(Workspace& ws, int& distance, int& numberOfRelocations, double cutoff, vector < vector < int > >* timeline) {
+
+    const vector < vector < int > >& pickupDistance = Data::getInstance().pickupDistance;
+    const vector < vector < int > >& deliveryDistance = Data::getInstance().deliveryDistance;
+    const double relocationWeight = beta * relocationCost;
+
+    // deliveryTour is the tour of the keys (position -> item) until the plan is replayed
+    vector < int >& pickupTour = ws.pickupTour;
+    vector < int >& deliveryTour = ws.deliveryTour;
+    vector < int >& position = ws.deliveryPosition;
+
+    pickupTour[0] = deliveryTour[0] = position[0] = 0;
+    for(int i = 0; i < n; ++i) {
+        pickupTour[i+1] = ws.keys[i].second + 1;
+        deliveryTour[i+1] = ws.keys[n+i].second + 1;
+        position[deliveryTour[i+1]] = i + 1;
+    }
+    pickupTour[n+1] = deliveryTour[n+1] = 0;
+    for(int k = 1; k <= n; ++k) ws.pickupPositions[k] = position[pickupTour[k]];
+
+    int pickup = 0;
+    for(int i = 1; i < n + 2; ++i) {
+        pickup += pickupDistance[pickupTour[i-1]][pickupTour[i]];
+    }
+
+    if(alpha * pickup > cutoff) return false;
+
+    vector < BeamState >& states = ws.beamStates;
+    vector < BeamState >& candidates = ws.candidates;
+    vector < int >& order = ws.candidateOrder;
+    int* window = ws.tourWindow.data();
+    int* sorted = ws.tourSorted.data();
+    const size_t width = (beamWidth > 0) ? beamWidth : numeric_limits < size_t > ::max();
+
+    const BeamState root = {0.0, 0.0, 0, 0, 0, 0, 0, 0, -1, 0};
+    states.assign(1, root);
+    ws.beamStacks.resize(n);
+    ws.beamMoves.clear();
+    int layerStart = 0;    // of the current states in beamMoves
+
+    for(int k = 1; k <= n + n; ++k) {
+
+        const bool isPickup = (k <= n);
+        const int top = isPickup ? k - 1 : n + n - k + 1;    // number of items before the step
+        const int groupSize = isPickup ? min(k, l + 1) : min(top, l + 1);
+        const int base = isPickup ? top - (groupSize - 1) : top - groupSize;
+        const int nextTop = isPickup ? top + 1 : top - 1;
+
+        candidates.clear();
+        ws.candidateStacks.resize(states.size() * (groupSize + 1) * n);
+
+        for(int j = 0; j < (int)states.size(); ++j) {
+
+            const int* stack = &ws.beamStacks[(size_t)j * n];
+
+            // the picked up item, then the ones taken off the top of the container
+            if(isPickup) {
+                window[0] = ws.pickupPositions[k];
+                for(int i = 1; i < groupSize; ++i) window[i] = stack[top - i];
+            }
+            else {
+                for(int i = 0; i < groupSize; ++i) window[i] = stack[top - 1 - i];
+            }
+            const int smallest = *min_element(window, window + groupSize);
+            const int next = isPickup ? 0 : *min_element(stack, stack + top);    // next position of the tour
+
+            // successor of state j whose window becomes result, sorted from entry move on
+            auto expand = [&](const int* result, int move) {
+
+                BeamState c = states[j];
+                c.parent = layerStart + j;
+                c.move = move;
+
+                for(int i = 0; i < groupSize; ++i) {
+                    if(result[i] != window[i]) {
+                        c.relocations += groupSize - i - 1;
+                        break;
+                    }
+                }
+
+                int* container = &ws.candidateStacks[candidates.size() * n];
+                copy(stack, stack + base, container);
+                for(int i = isPickup ? 0 : 1; i < groupSize; ++i) container[base + groupSize - 1 - i] = result[i];
+                if(!isPickup) {
+                    if(result[0] != next) c.deviations += 1;
+                    c.distance += deliveryDistance[deliveryTour[c.last]][deliveryTour[result[0]]];
+                    c.last = result[0];
+                }
+                c.cost = alpha * c.distance + relocationWeight * c.relocations;
+
+                c.hash = 14695981039346656037ULL;
+                for(int i = 0; i < nextTop; ++i) c.hash = (c.hash ^ (uint64_t)container[i]) * 1099511628211ULL;
+                c.hash = (c.hash ^ (uint64_t)c.last) * 1099511628211ULL;
+                candidates.push_back(c);
+            };
+
+            // a delivery must bring the smallest position of its window on top
+            if(isPickup || window[0] == smallest) expand(window, groupSize);
+
+            // sorted[] is the window sorted from entry i on; sorting from i - 1 gives the same
+            // window when window[i-1] is smaller than every entry after it
+            copy(window, window + groupSize, sorted);
+            bool suffixSorted = true;
+            int suffixMinimum = window[groupSize-1];
+            for(int i = groupSize - 2; i >= 0; --i) {
+                if(window[i] > window[i+1]) suffixSorted = false;
+                suffixMinimum = min(suffixMinimum, window[i]);
+                for(int x = i; x + 1 < groupSize && sorted[x] > sorted[x+1]; ++x) swap(sorted[x], sorted[x+1]);
+
+                if(suffixSorted || (i > 0 && window[i-1] < suffixMinimum)) continue;
+                if(!isPickup && i > 0 && window[0] != smallest) continue;
+                expand(sorted, i);
+            }
         }
-        
-        container.erase(--container.end());
-        
-        for(int i = 0; i < (int)container.size(); ++i) {
-            while((int)container[i].size() < n) container[i].push_back(-1);
+
+        // identical states are adjacent once sorted by hash: the first of each is the best one
+        BeamState* c = candidates.data();
+        const int* stacks = ws.candidateStacks.data();
+        order.resize(candidates.size());
+        for(int i = 0; i < (int)order.size(); ++i) order[i] = i;
+        sort(order.begin(), order.end(), [c](int a, int b) {
+            if(c[a].hash != c[b].hash) return c[a].hash < c[b].hash;
+            if(c[a].deviations != c[b].deviations) return c[a].deviations < c[b].deviations;
+            if(c[a].cost != c[b].cost) return c[a].cost < c[b].cost;
+            return a < b;
+        });
+
+        int kept = 0;
+        for(int r = 0; r < (int)order.size(); ++r) {
+            if(kept > 0) {
+                const int q = order[kept-1], s = order[r];
+                if(c[q].hash == c[s].hash && c[q].last == c[s].last && equal(stacks + (size_t)q * n, stacks + (size_t)q * n + nextTop, stacks + (size_t)s * n)) continue;
+            }
+            order[kept++] = order[r];
         }
-        
-        ofstream fout(solutionFileOut.c_str());
-    
-        fout << "Total cost: " << totalCost << endl;
-        fout << "Distance traveled: " << distance << endl;
-        fout << "Number of relocations: " << numberOfRelocations << endl << endl;
-        
-        fout << "Loading/unloading plan timeline:" << endl << endl;
+        order.resize(kept);
 
-        for(int j = n-1; j >= 0; --j) {
-            for(int i = 0; i < (int)container.size(); ++i) {
-                if(container[i][j] == -1) fout << "   ";
-                else fout << setfill('0') << setw(2) << container[i][j] << ' ';
+        if(order.size() > width) {
+            for(int r = 0; r < (int)order.size(); ++r) {
+                BeamState& s = c[order[r]];
+                int deviations = 0;
+                s.priority = s.cost + completeGreedily(ws, stacks + (size_t)order[r] * n, nextTop, k, s.last, deviations);
+                s.priorityDeviations = s.deviations + deviations;
             }
-            fout << endl;
+            nth_element(order.begin(), order.begin() + width, order.end(), [c](int a, int b) {
+                if(c[a].priorityDeviations != c[b].priorityDeviations) return c[a].priorityDeviations < c[b].priorityDeviations;
+                if(c[a].priority != c[b].priority) return c[a].priority < c[b].priority;
+                return a < b;
+            });
+            order.resize(width);
         }
-        
-        fout << endl;
 
-        fout << "Pickup tour  : 00";
-        for(int i = 1; i < (int)pickupTour.size(); ++i) {
-            fout << " --> " << setfill('0') << setw(2) << pickupTour[i];
+        // every cost only grows from here on
+        bool withinCutoff = false;
+        layerStart = ws.beamMoves.size();
+        states.resize(order.size());
+        ws.beamStacks.resize(order.size() * n);
+        for(int r = 0; r < (int)order.size(); ++r) {
+            states[r] = c[order[r]];
+            copy(stacks + (size_t)order[r] * n, stacks + (size_t)order[r] * n + nextTop, &ws.beamStacks[(size_t)r * n]);
+            ws.beamMoves.push_back(make_pair(states[r].parent, states[r].move));
+            if(alpha * pickup + states[r].cost <= cutoff) withinCutoff = true;
         }
-        fout << endl;
-        fout << "Delivery tour: 00";
-        for(int i = 1; i < (int)deliveryTour.size(); ++i) {
-            fout << " --> " << setfill('0') << setw(2) << deliveryTour[i];
+
+        if(!withinCutoff) return false;
+    }
+
+    int best = 0;
+    double bestCost = INF;
+    for(int r = 0; r < (int)states.size(); ++r) {
+        const double cost = states[r].cost + alpha * deliveryDistance[deliveryTour[states[r].last]][0];
+        if(states[r].deviations < states[best].deviations || (states[r].deviations == states[best].deviations && cost < bestCost)) {
+            best = r;
+            bestCost = cost;
+        }
+    }
+
+    distance = pickup + states[best].distance + deliveryDistance[deliveryTour[states[best].last]][0];
+    numberOfRelocations = states[best].relocations;
+
+    if(timeline != NULL) {
+
+        vector < int > moves(n + n + 1);
+        for(int id = layerStart + best, k = n + n; k >= 1; --k) {
+            moves[k] = ws.beamMoves[id].second;
+            id = ws.beamMoves[id].first;
+        }
+
+        const vector < int > item(deliveryTour);
+        vector < int > stack;
+        for(int k = 1; k <= n + n; ++k) {
+
+            const bool isPickup = (k <= n);
+            const int top = stack.size();
+            const int groupSize = isPickup ? min(k, l + 1) : min(top, l + 1);
+
+            if(!isPickup) {
+                timeline->push_back(vector < int > ());
+                for(int i = 0; i < top; ++i) timeline->back().push_back(item[stack[i]]);
+            }
+
+            if(isPickup) stack.push_back(ws.pickupPositions[k]);
+            sort(stack.end() - groupSize, stack.end() - min(moves[k], groupSize), greater < int > ());
+
+            if(isPickup) {
+                timeline->push_back(vector < int > ());
+                for(int i = 0; i <= top; ++i) timeline->back().push_back(item[stack[i]]);
+            }
+            else {
+                deliveryTour[k-n] = item[stack.back()];
+                stack.pop_back();
+            }
+        }
+    }
+
+    return alpha * distance + relocationWeight * numberOfRelocations <= cutoff;
+}
+
+// Cost of the rest of a TOURS plan from the container left by step 'step', when every later step
+// sorts its whole window if the item it picks up (or must deliver) is out of order, and leaves it
+// as it is otherwise; the deliveries that leave the delivery tour are added to deviations
+double Decoder::completeGreedily(Workspace& ws, const int* stack, int top, int step, int last, int& deviations) const {
+
+    const vector < vector < int > >& deliveryDistance = Data::getInstance().deliveryDistance;
+    const vector < int >& item = ws.deliveryTour;
+    int* container = ws.rollout.data();
+    copy(stack, stack + top, container);
+
+    int distance = 0, relocations = 0;
+    for(int k = step + 1; k <= n + n; ++k) {
+
+        if(k <= n) {
+            const int groupSize = min(k, l + 1);
+            container[top++] = ws.pickupPositions[k];
+            if(groupSize > 1 && container[top-1] > container[top-2]) {
+                sort(container + top - groupSize, container + top, greater < int > ());
+                relocations += groupSize - 1;
+            }
+        }
+        else {
+            const int groupSize = min(top, l + 1);
+            if(*min_element(container + top - groupSize, container + top) != container[top-1]) {
+                sort(container + top - groupSize, container + top, greater < int > ());
+                relocations += groupSize - 1;
+            }
+            if(*min_element(container, container + top) != container[top-1]) deviations += 1;
+            distance += deliveryDistance[item[last]][item[container[top-1]]];
+            last = container[--top];
+        }
+    }
+    distance += deliveryDistance[item[last]][0];
+
+    return alpha * distance + beta * relocationCost * relocations;
+}
+
+template< class Key >
+bool Decoder::decodeSolution(Span< const Key > chromosome, unsigned threadId, double cutoff, int& distance, int& numberOfRelocations) {
+
+    switch(depth) {
+        case 0: return decodeSolutionDepth< Key, 0 >(chromosome, threadId, cutoff, distance, numberOfRelocations);
+        case 1: return decodeSolutionDepth< Key, 1 >(chromosome, threadId, cutoff, distance, numberOfRelocations);
+        case 2: return decodeSolutionDepth< Key, 2 >(chromosome, threadId, cutoff, distance, numberOfRelocations);
+        case 3: return decodeSolutionDepth< Key, 3 >(chromosome, threadId, cutoff, distance, numberOfRelocations);
+        case 4: return decodeSolutionDepth< Key, 4 >(chromosome, threadId, cutoff, distance, numberOfRelocations);
+        case 5: return decodeSolutionDepth< Key, 5 >(chromosome, threadId, cutoff, distance, numberOfRelocations);
+        default: return decodeSolutionDepth< Key, GENERIC_DEPTH >(chromosome, threadId, cutoff, distance, numberOfRelocations);
+    }
+}
+
+// Decodes up to the cutoff, through the cache if enabled, and records fully decoded solutions in the
+// archives of the thread; returns false if the cost exceeds the cutoff
+template< class Key, int Depth >
+bool Decoder::decodeSolutionDepth(Span< const Key > chromosome, unsigned threadId, double cutoff, int& distance, int& numberOfRelocations) {
+
+    Workspace& ws = workspaces[threadId];
+
+    if(cache.enabled()) {
+        // a cached solution was fully decoded before, so it is already in the archives
+        const uint64_t hash = sortAllGroups< Key, Depth >(chromosome, ws);
+        ws.cacheLookups += 1;
+        if(cache.lookup(hash, distance, numberOfRelocations)) {
+            ws.cacheHits += 1;
+            int totalCost = alpha * distance + beta * relocationCost * numberOfRelocations;
+            return totalCost <= cutoff;    // as if decoding had stopped at the cutoff
+        }
+        const bool complete = (encoding == TOURS)
+            ? evaluateTours(chromosome, ws, distance, numberOfRelocations, cutoff, NULL, true)
+            : (Depth == GENERIC_DEPTH)
+            ? evaluate(chromosome, ws, distance, numberOfRelocations, cutoff, NULL, true)
+            : evaluateFixed< Key, Depth >(chromosome, ws, distance, numberOfRelocations, cutoff, NULL, true);
+        if(!complete) return false;
+        cache.insert(hash, distance, numberOfRelocations);
+    }
+    else {
+        const bool complete = (encoding == TOURS)
+            ? evaluateTours(chromosome, ws, distance, numberOfRelocations, cutoff, NULL, false)
+            : (Depth == GENERIC_DEPTH)
+            ? evaluate(chromosome, ws, distance, numberOfRelocations, cutoff)
+            : evaluateFixed< Key, Depth >(chromosome, ws, distance, numberOfRelocations, cutoff, NULL, false);
+        if(!complete) return false;
+    }
+
+    ws.nds.add(make_pair(distance, numberOfRelocations));
+    if(!trackedCosts.empty()) updateIncumbents(chromosome, ws, distance, numberOfRelocations);
+
+    return true;
+}
+
+template< class Key >
+double Decoder::decodeKeys(Span< const Key > chromosome, unsigned threadId, double cutoff) {
+
+    int distance, numberOfRelocations;
+    if(!trackedCosts.empty()) cutoff = INF;    // see trackRelocationCosts()
+    if(!decodeSolution(chromosome, threadId, cutoff, distance, numberOfRelocations)) return INF;
+
+    int totalCost = alpha * distance + beta * relocationCost * numberOfRelocations;
+    return totalCost;
+}
+
+template< class Key >
+pair < int, int > Decoder::decodeObjectivesKeys(Span< const Key > chromosome, unsigned threadId) {
+
+    int distance, numberOfRelocations;
+    decodeSolution(chromosome, threadId, INF, distance, numberOfRelocations);
+    return make_pair(distance, numberOfRelocations);
+}
+
+template< class Key >
+vector < vector < int > > Decoder::decodeTimelineKeys(Span< const Key > chromosome, unsigned threadId) {
+
+    Workspace& ws = workspaces[threadId];
+    int distance, numberOfRelocations;
+    vector < vector < int > > container;
+
+    if(encoding == TOURS) evaluateTours(chromosome, ws, distance, numberOfRelocations, INF, &container, false);
+    else evaluate(chromosome, ws, distance, numberOfRelocations, INF, &container);
+
+    return container;
+}
+
+template< class Key >
+void Decoder::saveSolutionKeys(Span< const Key > chromosome, const string solutionFileOut) {
+
+    Workspace& ws = workspaces[0];
+    int distance, numberOfRelocations;
+    vector < vector < int > > container;
+
+    if(encoding == TOURS) evaluateTours(chromosome, ws, distance, numberOfRelocations, INF, &container, false);
+    else evaluate(chromosome, ws, distance, numberOfRelocations, INF, &container);
+
+    int totalCost = alpha * distance + beta * relocationCost * numberOfRelocations;
+
+    for(int i = 0; i < (int)container.size(); ++i) {
+        while((int)container[i].size() < n) container[i].push_back(-1);
+    }
+
+    ofstream fout(solutionFileOut.c_str());
+
+    fout << "Total cost: " << totalCost << endl;
+    fout << "Distance traveled: " << distance << endl;
+    fout << "Number of relocations: " << numberOfRelocations << endl << endl;
+
+    fout << "Loading/unloading plan timeline:" << endl << endl;
+
+    for(int j = n-1; j >= 0; --j) {
+        for(int i = 0; i < (int)container.size(); ++i) {
+            if(container[i][j] == -1) fout << "   ";
+            else fout << setfill('0') << setw(2) << container[i][j] << ' ';
         }
         fout << endl;
-        
-        fout.close();
     }
-    
+
+    fout << endl;
+
+    fout << "Pickup tour  : 00";
+    for(int i = 1; i < (int)ws.pickupTour.size(); ++i) {
+        fout << " --> " << setfill('0') << setw(2) << ws.pickupTour[i];
+    }
+    fout << endl;
+    fout << "Delivery tour: 00";
+    for(int i = 1; i < (int)ws.deliveryTour.size(); ++i) {
+        fout << " --> " << setfill('0') << setw(2) << ws.deliveryTour[i];
+    }
+    fout << endl;
+
+    fout.close();
+
     nds.add(make_pair(distance, numberOfRelocations));
-        
-    return totalCost;
+}
+
+// Decodes the chromosome fully and records, besides the tours, the items that enter every
+// rearrangement and the position of every item in the delivery tour
+template< class Key >
+void Decoder::buildPlan(Span< const Key > chromosome, Workspace& ws, int& distance, int& numberOfRelocations) {
+
+    for(int g = 0; g + 1 < (int)groupOffset.size(); ++g) sortGroup< Key, GENERIC_DEPTH >(chromosome, ws, g);
+    evaluate(chromosome, ws, distance, numberOfRelocations, INF, NULL, true);
+
+    // same moves as evaluate(), replayed to see which items each rearrangement takes
+    ws.stack.resize(n);
+    int* stack = ws.stack.data();
+    int top = 0;
+
+    for(int k = 1; k <= n + n; ++k) {
+
+        const pair < double, int >* group = &ws.keys[groupOffset[k]];
+        const int groupSize = groupOffset[k+1] - groupOffset[k];
+        int* items = &ws.stepItems[groupOffset[k]];
+
+        int base;
+        if(k <= n) {
+            items[0] = ws.pickupTour[k];
+            for(int i = 1; i < groupSize; ++i) items[i] = stack[top - i];
+            base = top - (groupSize - 1);
+        }
+        else {
+            for(int i = 0; i < groupSize; ++i) items[i] = stack[top - 1 - i];
+            base = top - groupSize;
+        }
+
+        for(int i = 0; i < groupSize; ++i) stack[base + groupSize - 1 - group[i].second] = items[i];
+        top = base + groupSize;
+        if(k > n) top -= 1;
+    }
+
+    for(int d = 1; d <= n; ++d) ws.deliveryPosition[ws.deliveryTour[d]] = d;
+}
+
+// With the rearrangement keys fixed, the container moves depend on positions only: the item picked
+// up k-th is always delivered at the same position of the delivery tour, whatever it is. Hence
+// - swapping two pickups swaps their items in the delivery tour too, and leaves the relocations as
+//   they are: an O(1) change in cost;
+// - swapping the ranks of two inputs of one rearrangement swaps their items in the delivery tour,
+//   and only changes the relocations of that rearrangement: an O(l) change in cost.
+// 2-opt or Or-opt moves on the pickup tour would displace a whole segment of the delivery tour, so
+// they are left out. The first improving move is applied to the keys, and the plan is rebuilt.
+template< class Key >
+double Decoder::improveKeys(Span< Key > chromosome, unsigned threadId) {
+
+    if(encoding == TOURS) return improveTours(chromosome, threadId);
+
+    Workspace& ws = workspaces[threadId];
+    const vector < vector < int > >& pickupDistance = Data::getInstance().pickupDistance;
+    const vector < vector < int > >& deliveryDistance = Data::getInstance().deliveryDistance;
+    const double relocationWeight = beta * relocationCost;
+
+    const vector < int >& pickupTour = ws.pickupTour;
+    const vector < int >& deliveryTour = ws.deliveryTour;
+    const vector < int >& deliveryPosition = ws.deliveryPosition;
+
+    bool improved = true;
+    while(improved) {
+
+        improved = false;
+
+        int distance, numberOfRelocations;
+        buildPlan(Span< const Key >(chromosome), ws, distance, numberOfRelocations);
+
+        // 1. Swap two pickups: item x takes the key of item y in the pickup group, and vice versa
+        for(int a = 1; a <= n && !improved; ++a) {
+            for(int b = a + 1; b <= n && !improved; ++b) {
+                if(isTied(&ws.keys[0], n, a - 1) || isTied(&ws.keys[0], n, b - 1)) continue;
+                const int x = pickupTour[a], y = pickupTour[b];
+
+                const double delta = alpha * (tourSwapDelta(pickupTour, a, b, pickupDistance)
+                                            + tourSwapDelta(deliveryTour, deliveryPosition[x], deliveryPosition[y], deliveryDistance));
+                if(delta < -EPS) {
+                    swap(chromosome[x-1], chromosome[y-1]);
+                    improved = true;
+                }
+            }
+        }
+
+        // 2. Swap the ranks of two inputs of a rearrangement, i.e., two keys of its group
+        for(int k = 1; k <= n + n && !improved; ++k) {
+
+            const pair < double, int >* group = &ws.keys[groupOffset[k]];
+            const int groupSize = groupOffset[k+1] - groupOffset[k];
+            const int* items = &ws.stepItems[groupOffset[k]];
+            const int relocations = relocationsAfterSwap(group, groupSize, 0, 0);
+
+            for(int i = 0; i < groupSize && !improved; ++i) {
+                for(int j = i + 1; j < groupSize && !improved; ++j) {
+                    if(isTied(group, groupSize, i) || isTied(group, groupSize, j)) continue;
+                    Key& ki = chromosome[groupOffset[k] + group[i].second];
+                    Key& kj = chromosome[groupOffset[k] + group[j].second];
+
+                    const double delta = alpha * tourSwapDelta(deliveryTour, deliveryPosition[items[i]], deliveryPosition[items[j]], deliveryDistance)
+                                       + relocationWeight * (relocationsAfterSwap(group, groupSize, i, j) - relocations);
+                    if(delta < -EPS) {
+                        swap(ki, kj);
+                        improved = true;
+                    }
+                }
+            }
+        }
+    }
+
+    return decodeKeys(Span< const Key >(chromosome), threadId, INF);
+}
+
+// Local search of TOURS chromosomes: swaps two consecutive stops of the pickup tour or of the
+// delivery tour, i.e., the keys of two items next to each other in the order of their group, while
+// that lowers the fitness. The loading plan changes with the tours, so every move is decoded.
+template< class Key >
+double Decoder::improveTours(Span< Key > chromosome, unsigned threadId) {
+
+    Workspace& ws = workspaces[threadId];
+    double fitness = decodeKeys(Span< const Key >(chromosome), threadId, INF);
+    vector < int >& order = ws.keyOrder;
+
+    bool improved = true;
+    while(improved) {
+
+        improved = false;
+
+        for(int g = 0; g < 2; ++g) {
+
+            sortGroup< Key, GENERIC_DEPTH >(Span< const Key >(chromosome), ws, g);
+            for(int i = 0; i < n; ++i) order[i] = ws.keys[groupOffset[g] + i].second;
+
+            for(int i = 0; i + 1 < n; ++i) {
+                Key& a = chromosome[groupOffset[g] + order[i]];
+                Key& b = chromosome[groupOffset[g] + order[i+1]];
+                if(a == b) continue;    // tied keys are ordered by index, whatever their values
+
+                swap(a, b);
+                const double cost = decodeKeys(Span< const Key >(chromosome), threadId, fitness);
+                if(cost < fitness - EPS) {
+                    fitness = cost;
+                    improved = true;
+                    // a moved key may now tie with another one, so the order is taken again
+                    sortGroup< Key, GENERIC_DEPTH >(Span< const Key >(chromosome), ws, g);
+                    for(int x = 0; x < n; ++x) order[x] = ws.keys[groupOffset[g] + x].second;
+                }
+                else swap(a, b);
+            }
+        }
+    }
+
+    return fitness;
+}
+
+// A chromosome decodes to 2n steps: pickup step k takes the k-th item of the pickup tour and the
+// ranks of group k, and delivery step k the ranks of group k. Sorting the batch by these steps lists
+// the leaves of the trie of decoded prefixes in depth-first order, so each chromosome shares its
+// longest prefix with the one before it. The stack is rolled back to the end of that prefix, with
+// the entries every step overwrote, and only the remaining steps are simulated; with the solution
+// cache, chromosomes found in it are not simulated at all. Chromosomes share few steps (a few percent
+// in a population), so this mostly pays for a simulation leaner than evaluate(). It does not beat the
+// specialised decoders, which sort a group only when its step is reached, so for depths up to
+// MAX_FIXED_DEPTH (and for TOURS) the chromosomes are simply decoded one by one.
+template< class Key >
+void Decoder::decodeBatchKeys(const vector < Span< const Key > >& chromosomes, vector < double >& fitness, unsigned threadId, double cutoff) {
+
+    const int count = chromosomes.size();
+    fitness.resize(count);
+    if(!trackedCosts.empty()) cutoff = INF;    // see trackRelocationCosts()
+
+    if(depth != GENERIC_DEPTH || encoding == TOURS) {
+        for(int c = 0; c < count; ++c) fitness[c] = decodeKeys(chromosomes[c], threadId, cutoff);
+        return;
+    }
+
+    Workspace& ws = workspaces[threadId];
+    const vector < vector < int > >& pickupDistance = Data::getInstance().pickupDistance;
+    const vector < vector < int > >& deliveryDistance = Data::getInstance().deliveryDistance;
+    const double relocationWeight = beta * relocationCost;
+
+    // a chromosome is length tokens, step k starting at stepStart[k]
+    const int length = groupOffset.back();
+
+    // 1. The steps of every chromosome, not in the cache, whose pickup tour alone is within the cutoff
+    vector < unsigned >& order = ws.batchOrder;
+    order.clear();
+    ws.batchSteps.resize((size_t)count * length);
+    ws.batchPickupDistance.resize(count);
+    ws.batchHash.resize(count);
+    for(int c = 0; c < count; ++c) {
+
+        fitness[c] = INF;
+
+        if(cache.enabled()) {
+            // a cached solution was fully decoded before, so it is already in the archives
+            const uint64_t hash = sortAllGroups< Key, GENERIC_DEPTH >(chromosomes[c], ws);
+            ws.cacheLookups += 1;
+            int distance, numberOfRelocations;
+            if(cache.lookup(hash, distance, numberOfRelocations)) {
+                ws.cacheHits += 1;
+                int totalCost = alpha * distance + beta * relocationCost * numberOfRelocations;
+                if(totalCost <= cutoff) fitness[c] = totalCost;
+                continue;
+            }
+            ws.batchHash[c] = hash;
+        }
+        else sortGroup< Key, GENERIC_DEPTH >(chromosomes[c], ws, 0);
+
+        int distance = 0, previous = 0;
+        for(int i = 0; i < n; ++i) {
+            distance += pickupDistance[previous][ws.keys[i].second + 1];
+            previous = ws.keys[i].second + 1;
+        }
+        distance += pickupDistance[previous][0];
+        ws.batchPickupDistance[c] = distance;
+
+        if(alpha * distance > cutoff) continue;
+        order.push_back(c);
+
+        for(int g = 1; g + 1 < (int)groupOffset.size() && !cache.enabled(); ++g) sortGroup< Key, GENERIC_DEPTH >(chromosomes[c], ws, g);
+
+        int* steps = &ws.batchSteps[(size_t)c * length];
+        int t = 0;
+        for(int k = 1; k <= n + n; ++k) {
+            if(k <= n) steps[t++] = ws.keys[k-1].second + 1;
+            for(int id = groupOffset[k]; id < groupOffset[k+1]; ++id) steps[t++] = ws.keys[id].second;
+        }
+    }
+
+    // 2. Depth-first order of the trie
+    const int* allSteps = ws.batchSteps.data();
+    sort(order.begin(), order.end(), [allSteps, length](unsigned a, unsigned b) {
+        const int* sa = allSteps + (size_t)a * length;
+        const int* sb = allSteps + (size_t)b * length;
+        pair < const int*, const int* > m = mismatch(sa, sa + length, sb);
+        return (m.first == sa + length) ? a < b : *m.first < *m.second;
+    });
+
+    // 3. Simulation
+    ws.stack.resize(n);
+    int* stack = ws.stack.data();
+    ws.stepTop[0] = ws.stepRelocations[0] = ws.stepDistance[0] = ws.stepLast[0] = 0;
+    int current = 0;    // last step simulated, whose state the stack holds
+    const int* previousSteps = NULL;
+
+    for(int r = 0; r < (int)order.size(); ++r) {
+
+        const int c = order[r];
+        const int* steps = allSteps + (size_t)c * length;
+
+        int shared = 0;
+        if(previousSteps != NULL) {
+            const int firstDifference = mismatch(steps, steps + length, previousSteps).first - steps;
+            shared = min(current, int(upper_bound(stepStart.begin() + 1, stepStart.end(), firstDifference) - stepStart.begin()) - 2);
+        }
+
+        for(; current > shared; --current) {
+            const int groupSize = groupOffset[current+1] - groupOffset[current];
+            const int base = ws.stepTop[current-1] - ((current <= n) ? groupSize - 1 : groupSize);
+            copy(&ws.undo[groupOffset[current]], &ws.undo[groupOffset[current]] + groupSize, stack + base);
+        }
+
+        const int pickup = ws.batchPickupDistance[c];
+        bool complete = alpha * (pickup + ws.stepDistance[current]) + relocationWeight * ws.stepRelocations[current] <= cutoff;
+
+        for(int k = current + 1; k <= n + n && complete; ++k) {
+
+            const int groupSize = groupOffset[k+1] - groupOffset[k];
+            const int* ranks = steps + stepStart[k] + ((k <= n) ? 1 : 0);
+            int top = ws.stepTop[k-1];
+            const int base = top - ((k <= n) ? groupSize - 1 : groupSize);
+
+            // the window is read back from the entries it is about to overwrite
+            int* old = &ws.undo[groupOffset[k]];
+            copy(stack + base, stack + base + groupSize, old);
+            for(int i = 0; i < groupSize; ++i) {
+                const int item = (k <= n && i == 0) ? steps[stepStart[k]] : old[groupSize - 1 - i];
+                stack[base + groupSize - 1 - ranks[i]] = item;
+            }
+            top = base + groupSize;
+
+            int relocations = ws.stepRelocations[k-1];
+            for(int i = 0; i < groupSize; ++i) {
+                if(ranks[i] != i) {
+                    relocations += groupSize - i - 1;
+                    break;
+                }
+            }
+
+            int distance = ws.stepDistance[k-1], last = ws.stepLast[k-1];
+            if(k > n) {
+                top -= 1;
+                distance += deliveryDistance[last][stack[top]];
+                last = stack[top];
+            }
+
+            ws.stepTop[k] = top;
+            ws.stepRelocations[k] = relocations;
+            ws.stepDistance[k] = distance;
+            ws.stepLast[k] = last;
+            current = k;
+
+            complete = alpha * (pickup + distance) + relocationWeight * relocations <= cutoff;
+        }
+
+        previousSteps = steps;
+
+        const int distance = pickup + ws.stepDistance[current] + deliveryDistance[ws.stepLast[current]][0];
+        const int numberOfRelocations = ws.stepRelocations[current];
+        if(complete && current == n + n && alpha * distance + relocationWeight * numberOfRelocations <= cutoff) {
+            if(cache.enabled()) cache.insert(ws.batchHash[c], distance, numberOfRelocations);
+            ws.nds.add(make_pair(distance, numberOfRelocations));
+            if(!trackedCosts.empty()) updateIncumbents(chromosomes[c], ws, distance, numberOfRelocations);
+            int totalCost = alpha * distance + beta * relocationCost * numberOfRelocations;
+            fitness[c] = totalCost;
+        }
+    }
+}
+
+template double Decoder::decodeKeys(Span< const double >, unsigned, double);
+template double Decoder::decodeKeys(Span< const float >, unsigned, double);
+template double Decoder::decodeKeys(Span< const FixedKey16 >, unsigned, double);
+template pair < int, int > Decoder::decodeObjectivesKeys(Span< const double >, unsigned);
+template pair < int, int > Decoder::decodeObjectivesKeys(Span< const float >, unsigned);
+template pair < int, int > Decoder::decodeObjectivesKeys(Span< const FixedKey16 >, unsigned);
+template void Decoder::saveSolutionKeys(Span< const double >, const string);
+template void Decoder::saveSolutionKeys(Span< const float >, const string);
+template void Decoder::saveSolutionKeys(Span< const FixedKey16 >, const string);
+template vector < vector < int > > Decoder::decodeTimelineKeys(Span< const double >, unsigned);
+template vector < vector < int > > Decoder::decodeTimelineKeys(Span< const float >, unsigned);
+template vector < vector < int > > Decoder::decodeTimelineKeys(Span< const FixedKey16 >, unsigned);
+template double Decoder::improveKeys(Span< double >, unsigned);
+template double Decoder::improveKeys(Span< float >, unsigned);
+template double Decoder::improveKeys(Span< FixedKey16 >, unsigned);
+template void Decoder::decodeBatchKeys(const vector < Span< const double > >&, vector < double >&, unsigned, double);
+template void Decoder::decodeBatchKeys(const vector < Span< const float > >&, vector < double >&, unsigned, double);
+template void Decoder::decodeBatchKeys(const vector < Span< const FixedKey16 > >&, vector < double >&, unsigned, double);
+
+void Decoder::mergeArchives() {
+
+    for(int t = 0; t < (int)workspaces.size(); ++t) {
+        nds.merge(workspaces[t].nds);
+        for(int i = 0; i < (int)trackedCosts.size(); ++i) {
+            const Workspace& ws = workspaces[t];
+            if(ws.incumbentCost[i] < incumbentCost[i] || (ws.incumbentCost[i] == incumbentCost[i] && ws.incumbentKeys[i] < incumbentKeys[i])) {
+                incumbentCost[i] = ws.incumbentCost[i];
+                incumbentKeys[i] = ws.incumbentKeys[i];
+            }
+        }
+    }
+    // threads only need to record solutions at least as good as the merged incumbents from now on
+    for(int t = 0; t < (int)workspaces.size(); ++t) {
+        workspaces[t].incumbentCost = incumbentCost;
+        workspaces[t].incumbentKeys = incumbentKeys;
+    }
+}
+
+long long Decoder::getCacheLookups() const {
+
+    long long lookups = 0;
+    for(int t = 0; t < (int)workspaces.size(); ++t) lookups += workspaces[t].cacheLookups;
+    return lookups;
+}
+
+long long Decoder::getCacheHits() const {
+
+    long long hits = 0;
+    for(int t = 0; t < (int)workspaces.size(); ++t) hits += workspaces[t].cacheHits;
+    return hits;
 }
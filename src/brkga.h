@@ -5,11 +5,27 @@
 #include <cmath>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <climits>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#ifdef __linux__
+    #include <sys/mman.h>
+#endif
+
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
 
 #include "data.h"
-#include "tsp_solver.h"
+#include "tsp_heuristic.h"
 #include "non_dominated_set.h"
+#include "solution_cache.h"
 
 using namespace std;
 
@@ -115,6 +131,10 @@ public:
     double rand();        // calls rand53() -- modified by rtoso
     double rand53();      // real number in [0,1)
     
+    // Bulk access, as required by the BRKGA RNG concept
+    void fill( double* out, const unsigned count );        // count calls to rand()
+    void fillBits( uint32_t* out, const unsigned count );  // count 32-bit words
+    
     // Access to nonuniform random number distributions
     double randNorm( const double mean = 0.0, const double stddev = 1.0 );
     
@@ -351,6 +371,12 @@ inline double MTRand::rand53()
 inline double MTRand::rand()
     { return rand53(); }
 
+inline void MTRand::fill( double* out, const unsigned count )
+    { for( unsigned i = 0; i < count; ++i ) out[i] = rand53(); }
+
+inline void MTRand::fillBits( uint32_t* out, const unsigned count )
+    { for( unsigned i = 0; i < count; ++i ) out[i] = uint32_t( randInt() ); }
+
 inline double MTRand::randNorm( const double mean, const double stddev )
 {
     // Return a real number from a normal (Gaussian) distribution with given
@@ -471,22 +497,200 @@ inline MTRand& MTRand::operator=( const MTRand& o )
 
 //=====================================================================================================================//
 
+/*
+ * PhiloxRNG.h
+ *
+ * Counter-based generator Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+ * 3", SC 2011). Block c of the stream is a fixed function of (seed, c), with no state carried from
+ * one block to the next, so a whole buffer is filled by a loop of independent iterations that the
+ * compiler can vectorise. Implements the same interface as MTRand.
+ *
+ * The upper half of the 128-bit counter selects one of 2^64 independent streams of a seed, so any
+ * stream can be opened directly, without generating or skipping the streams before it.
+ */
+
+class PhiloxRNG {
+public:
+    explicit PhiloxRNG(unsigned long seed = 0, uint64_t stream = 0) { this->seed(seed, stream); }
+
+    void seed(unsigned long seed, uint64_t stream = 0) {
+        key[0] = uint32_t(seed);
+        key[1] = uint32_t(uint64_t(seed) >> 32);
+        this->stream = stream;
+        counter = 0;
+        left = 0;
+    }
+
+    uint32_t randInt() {
+        if(left == 0) { block(counter++, buffer); left = 4; }
+        return buffer[4 - left--];
+    }
+
+    // integer in [0,n], drawn as in MTRand::randInt(n)
+    uint32_t randInt(const uint32_t n) {
+        uint32_t used = n;
+        used |= used >> 1;
+        used |= used >> 2;
+        used |= used >> 4;
+        used |= used >> 8;
+        used |= used >> 16;
+
+        uint32_t i;
+        do { i = randInt() & used; } while(i > n);
+        return i;
+    }
+
+    double rand() {
+        const uint32_t a = randInt() >> 5, b = randInt() >> 6;
+        return (a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
+    }
+
+    void fillBits(uint32_t* out, unsigned count) {
+        while(count > 0 && left > 0) { *out++ = randInt(); --count; }
+
+        const uint64_t blocks = count / 4;
+        for(uint64_t c = 0; c < blocks; ++c) { block(counter + c, out + 4 * c); }
+        counter += blocks;
+        out += 4 * blocks;
+        count -= 4 * blocks;
+
+        while(count > 0) { *out++ = randInt(); --count; }
+    }
+
+    void fill(double* out, unsigned count) {
+        uint32_t words[512];
+        while(count > 0) {
+            const unsigned chunk = std::min(count, 256u);
+            fillBits(words, 2 * chunk);
+            for(unsigned i = 0; i < chunk; ++i) {
+                out[i] = ((words[2*i] >> 5) * 67108864.0 + (words[2*i+1] >> 6)) * (1.0 / 9007199254740992.0);
+            }
+            out += chunk;
+            count -= chunk;
+        }
+    }
+
+private:
+    uint32_t key[2];
+    uint64_t stream;        // upper half of the counter
+    uint64_t counter;       // index of the next block to generate
+    uint32_t buffer[4];     // last block, of which 'left' words are still unused
+    unsigned left;
+
+    void block(uint64_t c, uint32_t* out) const {
+        uint32_t x0 = uint32_t(c), x1 = uint32_t(c >> 32), x2 = uint32_t(stream), x3 = uint32_t(stream >> 32);
+        uint32_t k0 = key[0], k1 = key[1];
+        for(int round = 0; round < 10; ++round) {
+            const uint64_t p0 = uint64_t(0xD2511F53u) * x0;
+            const uint64_t p1 = uint64_t(0xCD9E8D57u) * x2;
+            const uint32_t y0 = uint32_t(p1 >> 32) ^ x1 ^ k0;
+            const uint32_t y2 = uint32_t(p0 >> 32) ^ x3 ^ k1;
+            x1 = uint32_t(p1);
+            x3 = uint32_t(p0);
+            x0 = y0;
+            x2 = y2;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        out[0] = x0; out[1] = x1; out[2] = x2; out[3] = x3;
+    }
+};
+
+//=====================================================================================================================//
+
+/*
+ * Span.h
+ *
+ * Non-owning view of a contiguous block of alleles (C++11 has no std::span). Chromosomes are handed
+ * around as Span< Key > or Span< const Key >, whether they live in a Population or in a
+ * std::vector.
+ */
+
+template< class T >
+class Span {
+public:
+    typedef typename std::remove_const< T >::type value_type;
+
+    Span() : ptr(NULL), len(0) {}
+    Span(T* _ptr, unsigned _len) : ptr(_ptr), len(_len) {}
+    Span(std::vector< value_type >& v) : ptr(v.data()), len(v.size()) {}
+    Span(const std::vector< value_type >& v) : ptr(v.data()), len(v.size()) {}
+    template< class U >
+    Span(const Span< U >& other) : ptr(other.data()), len(other.size()) {}
+
+    T& operator[](unsigned i) const { return ptr[i]; }
+    T* data() const { return ptr; }
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + len; }
+    unsigned size() const { return len; }
+
+private:
+    T* ptr;
+    unsigned len;
+};
+
+//=====================================================================================================================//
+
+/*
+ * KeyTraits.h
+ *
+ * Random keys may be stored with less precision than a double to save memory and bandwidth. Every
+ * key type maps [0,1) onto its own representation; decoders only compare keys, and break ties by
+ * allele index, so a smaller key type changes nothing but the resolution of the keys.
+ */
+
+typedef unsigned short FixedKey16;    // 16-bit fixed-point key: value k stands for k / 65536
+
+template< class Key >
+struct KeyTraits;
+
+template<>
+struct KeyTraits< double > {
+    static double fromUnit(double u) { return u; }
+    static double toUnit(double k) { return k; }
+};
+
+template<>
+struct KeyTraits< float > {
+    static float fromUnit(double u) {
+        const float k = static_cast< float >(u);
+        return (k < 1.0f) ? k : std::nextafter(1.0f, 0.0f);    // rounding must not reach 1
+    }
+    static double toUnit(float k) { return k; }
+};
+
+template<>
+struct KeyTraits< FixedKey16 > {
+    static FixedKey16 fromUnit(double u) { return static_cast< FixedKey16 >(u * 65536.0); }
+    static double toUnit(FixedKey16 k) { return k / 65536.0; }
+};
+
+//=====================================================================================================================//
+
 /*
  * Population.h
  *
- * Encapsulates a population of chromosomes represented by a vector of doubles. We don't decode
+ * Encapsulates a population of chromosomes stored as one flat matrix of keys, where every row
+ * (chromosome) starts on a cache line and rows are handed out as Spans. Chromosome slots map to
+ * rows through a permutation, and the matrix may have spare rows, where the next generation is
+ * built while the current one is read: the slots that survive into it keep their rows, so they are
+ * never copied (see beginGeneration() and endGeneration()). We don't decode
  * nor deal with random numbers here; instead, we provide private support methods to set the
  * fitness of a specific chromosome as well as access methods to each allele. Note that the BRKGA
- * class must have access to such methods and thus is a friend.
+ * class and its ranking policies must have access to such methods and thus are friends.
  *
  *  Created on : Jun 21, 2010 by rtoso
  *  Last update: Nov 15, 2010 by rtoso
  *      Authors: Rodrigo Franco Toso <rtoso@cs.rutgers.edu>
  */
 
+template< class Key = double >
 class Population {
-    template< class Decoder, class RNG >
+    template< class Decoder, class RNG, class K, class Ranking >
     friend class BRKGA;
+    friend struct FitnessRanking;
+    friend class ParetoRanking;
+    friend struct RankingBenchmark;    // times the ranking alone, in benchmark.cpp
 
 public:
     unsigned getN() const;    // Size of each chromosome
@@ -494,85 +698,391 @@ public:
 
     //double operator()(unsigned i, unsigned j) const;    // Direct access to allele j of chromosome i
 
-    // These methods REQUIRE fitness to be sorted, and thus a call to sortFitness() beforehand
-    // (this is done by BRKGA, so rest assured: everything will work just fine with BRKGA).
+    // These methods REQUIRE fitness to be ranked, and thus a call to sortFitness() or rankFitness()
+    // beforehand (this is done by BRKGA, so rest assured: everything will work just fine with BRKGA).
+    // After rankFitness(pe), ranks from pe on are ordered on first use, on a copy of the ranking.
     double getBestFitness() const;            // Returns the best fitness in this population
     double getFitness(unsigned i) const;    // Returns the fitness of chromosome i
-    const std::vector< double >& getChromosome(unsigned i) const;    // Returns i-th best chromosome
+    Span< const Key > getChromosome(unsigned i) const;    // Returns i-th best chromosome
 
 private:
+    enum { CACHE_LINE = 64 };
+    enum { HUGE_PAGE = 2 << 20 };
+
     Population(const Population& other);
-    Population(unsigned n, unsigned p);
+    Population(unsigned n, unsigned p, bool hugePages = false, unsigned spare = 0);
     ~Population();
-
-    std::vector< std::vector< double > > population;        // Population as vectors of prob.
+    Population& operator=(const Population& other);    // not implemented
+
+    unsigned n;                    // Size of each chromosome
+    unsigned p;                    // Size of population
+    unsigned rows;                // Rows of 'keys': p plus the spare ones
+    unsigned stride;            // Distance between consecutive rows of 'keys', in keys
+    bool hugePages;                // Whether 'keys' asks the kernel for transparent huge pages
+    Key* keys;                    // Population as a rows x stride matrix of prob.
     std::vector< std::pair< double, unsigned > > fitness;    // Fitness (double) of a each chromosome
-
+    std::vector< unsigned > slotRow;                        // Row of 'keys' of each chromosome
+    unsigned ranked;                                        // 'fitness' is in final order up to here
+
+    std::vector< uint64_t > packed;                         // Scratch space of the integer ranking
+    std::vector< uint64_t > packedScratch;
+    std::vector< unsigned > radixCount;                     // Scratch space of radixSortPacked()
+    mutable std::vector< std::pair< double, unsigned > > order;    // Ranking after 'ranked', on demand
+    mutable bool orderValid;
+
+    // Next generation, between beginGeneration() and endGeneration():
+    unsigned survivors;                                     // its first slots are the current best
+    std::vector< std::pair< double, unsigned > > nextFitness;
+    std::vector< unsigned > nextSlotRow;
+    std::vector< unsigned > spareRows;                      // rows that no current chromosome uses
+    std::vector< bool > usedRows;                           // Scratch space of endGeneration()
+
+    void allocate();
     void sortFitness();                                    // Sorts 'fitness' by its first parameter
+    // Moves the pe best chromosomes, in order, to the front of 'fitness', and leaves the others in
+    // any order after them
+    void rankFitness(unsigned pe);
+    // Whether every fitness is an integer in [0, 2^32); if so, stores each entry of 'fitness' in
+    // 'packed' as (fitness << 32) | chromosome, which orders exactly as the pairs do
+    bool packFitness();
+    void unpackFitness();
+    void radixSortPacked();                                // Sorts 'packed'
+    const std::pair< double, unsigned >& rank(unsigned i) const;    // Entry of the i-th best
     void setFitness(unsigned i, double f);                // Sets the fitness of chromosome i
-    std::vector< double >& getChromosome(unsigned i);    // Returns a chromosome
-
-    double& operator()(unsigned i, unsigned j);        // Direct access to allele j of chromosome i
-    std::vector< double >& operator()(unsigned i);    // Direct access to chromosome i
+    Span< Key > getChromosome(unsigned i);            // Returns a chromosome
+
+    Key& operator()(unsigned i, unsigned j);            // Direct access to allele j of chromosome i
+    Span< Key > operator()(unsigned i);            // Direct access to chromosome i
+
+    // Starts the next generation, whose slot i < pe is the i-th best chromosome, with its row and
+    // fitness; its other slots take the spare rows, so there must be at least p - pe of them
+    void beginGeneration(unsigned pe);
+    Span< Key > getNextChromosome(unsigned i);        // Slot i of the next generation
+    void setNextFitness(unsigned i, double f);        // Sets the fitness of slot i of the next generation
+    // Makes the next generation current, unsorted; the rows of the chromosomes that did not survive
+    // become spare
+    void endGeneration();
 };
 
-inline Population::Population(const Population& pop) :
-        population(pop.population),
-        fitness(pop.fitness) {
+template< class Key >
+inline Population< Key >::Population(const Population< Key >& pop) :
+        n(pop.n), p(pop.p), rows(pop.rows), stride(pop.stride), hugePages(pop.hugePages), keys(NULL),
+        fitness(pop.fitness), slotRow(pop.slotRow), ranked(pop.ranked), orderValid(false), survivors(0),
+        spareRows(pop.spareRows) {
+    allocate();
+    std::copy(pop.keys, pop.keys + (size_t)rows * stride, keys);
 }
 
-inline Population::Population(const unsigned n, const unsigned p) :
-        population(p, std::vector< double >(n, 0.0)), fitness(p) {
+template< class Key >
+inline Population< Key >::Population(const unsigned _n, const unsigned _p, bool _hugePages, unsigned spare) :
+        n(_n), p(_p), rows(_p + spare), stride(0), hugePages(_hugePages), keys(NULL), fitness(_p),
+        slotRow(_p), ranked(0), orderValid(false), survivors(0) {
     if(p == 0) { throw std::range_error("Population size p cannot be zero."); }
     if(n == 0) { throw std::range_error("Chromosome size n cannot be zero."); }
+
+    // Pad each row to a whole number of cache lines:
+    const unsigned perLine = CACHE_LINE / sizeof(Key);
+    stride = (n + perLine - 1) / perLine * perLine;
+
+    allocate();
+    std::fill(keys, keys + (size_t)rows * stride, Key());
+
+    for(unsigned i = 0; i < p; ++i) { slotRow[i] = i; }
+    for(unsigned r = p; r < rows; ++r) { spareRows.push_back(r); }
 }
 
-inline Population::~Population() {
+template< class Key >
+inline Population< Key >::~Population() {
+    free(keys);
+}
+
+template< class Key >
+inline void Population< Key >::allocate() {
+    const size_t bytes = (size_t)rows * stride * sizeof(Key);
+    const size_t alignment = (hugePages && bytes >= HUGE_PAGE) ? size_t(HUGE_PAGE) : size_t(CACHE_LINE);
+
+    void* memory = NULL;
+    if(posix_memalign(&memory, alignment, bytes) != 0) { throw std::bad_alloc(); }
+    keys = static_cast< Key* >(memory);
+
+    #ifdef MADV_HUGEPAGE
+        if(alignment == HUGE_PAGE) { madvise(memory, bytes, MADV_HUGEPAGE); }
+    #endif
 }
 
-inline unsigned Population::getN() const {
-    return population[0].size();
+template< class Key >
+inline unsigned Population< Key >::getN() const {
+    return n;
 }
 
-inline unsigned Population::getP() const {
-    return population.size();
+template< class Key >
+inline unsigned Population< Key >::getP() const {
+    return p;
 }
 
-inline double Population::getBestFitness() const {
+template< class Key >
+inline double Population< Key >::getBestFitness() const {
     return getFitness(0);
 }
 
-inline double Population::getFitness(unsigned i) const {
-    return fitness[i].first;
+template< class Key >
+inline double Population< Key >::getFitness(unsigned i) const {
+    return rank(i).first;
 }
 
-inline const std::vector< double >& Population::getChromosome(unsigned i) const {
-    return population[ fitness[i].second ];
+template< class Key >
+inline Span< const Key > Population< Key >::getChromosome(unsigned i) const {
+    return Span< const Key >(keys + (size_t)slotRow[rank(i).second] * stride, n);
 }
 
-inline std::vector< double >& Population::getChromosome(unsigned i) {
-    return population[ fitness[i].second ];
+template< class Key >
+inline const std::pair< double, unsigned >& Population< Key >::rank(unsigned i) const {
+    if(i < ranked) { return fitness[i]; }
+
+    // Observing the population must not reorder it, so the rest of the ranking is sorted on a copy:
+    if(!orderValid) {
+        order.assign(fitness.begin() + ranked, fitness.end());
+        std::sort(order.begin(), order.end());
+        orderValid = true;
+    }
+    return order[i - ranked];
 }
 
-inline void Population::setFitness(unsigned i, double f) {
+template< class Key >
+inline Span< Key > Population< Key >::getChromosome(unsigned i) {
+    return Span< Key >(keys + (size_t)slotRow[fitness[i].second] * stride, n);
+}
+
+template< class Key >
+inline void Population< Key >::setFitness(unsigned i, double f) {
     fitness[i].first = f;
     fitness[i].second = i;
+    ranked = 0;
+    orderValid = false;
+}
+
+template< class Key >
+inline void Population< Key >::sortFitness() {
+    if(packFitness()) {
+        radixSortPacked();
+        unpackFitness();
+    }
+    else { std::sort(fitness.begin(), fitness.end()); }
+
+    ranked = p;
+    orderValid = false;
 }
 
-inline void Population::sortFitness() {
-    sort(fitness.begin(), fitness.end());
+template< class Key >
+inline void Population< Key >::rankFitness(unsigned pe) {
+    if(pe >= p) { sortFitness(); return; }
+
+    // Only the elite needs an order: one selection splits it from the rest, then it alone is sorted.
+    // Packing the fitness costs more than it saves here (see the rank-elite rows of the benchmark)
+    std::nth_element(fitness.begin(), fitness.begin() + pe, fitness.end());
+    std::sort(fitness.begin(), fitness.begin() + pe);
+
+    ranked = pe;
+    orderValid = false;
+}
+
+template< class Key >
+inline bool Population< Key >::packFitness() {
+    packed.resize(p);
+    for(unsigned i = 0; i < p; ++i) {
+        const double f = fitness[i].first;
+        if(!(f >= 0.0 && f < 4294967296.0) || f != std::floor(f)) { return false; }
+        packed[i] = (uint64_t(f) << 32) | fitness[i].second;
+    }
+    return true;
+}
+
+template< class Key >
+inline void Population< Key >::unpackFitness() {
+    for(unsigned i = 0; i < p; ++i) {
+        fitness[i].first = double(packed[i] >> 32);
+        fitness[i].second = unsigned(packed[i] & 0xffffffffu);
+    }
+}
+
+template< class Key >
+inline void Population< Key >::radixSortPacked() {
+    // LSD radix sort on 11-bit digits. The counts of every digit come from a single pass, and a digit
+    // that is the same in all keys (e.g., the high bits of the chromosome index) needs no pass at all.
+    enum { BITS = 11, BUCKETS = 1 << BITS, DIGITS = (64 + BITS - 1) / BITS };
+
+    radixCount.assign((size_t)DIGITS * BUCKETS, 0);
+    for(unsigned i = 0; i < p; ++i) {
+        for(unsigned d = 0; d < DIGITS; ++d) { ++radixCount[d * BUCKETS + ((packed[i] >> (d * BITS)) & (BUCKETS - 1))]; }
+    }
+
+    packedScratch.resize(p);
+    for(unsigned d = 0; d < DIGITS; ++d) {
+        unsigned* digitCount = &radixCount[d * BUCKETS];
+        if(digitCount[(packed[0] >> (d * BITS)) & (BUCKETS - 1)] == p) { continue; }
+
+        unsigned offset = 0;
+        for(unsigned b = 0; b < BUCKETS; ++b) {
+            const unsigned c = digitCount[b];
+            digitCount[b] = offset;
+            offset += c;
+        }
+        for(unsigned i = 0; i < p; ++i) {
+            packedScratch[digitCount[(packed[i] >> (d * BITS)) & (BUCKETS - 1)]++] = packed[i];
+        }
+        packed.swap(packedScratch);
+    }
 }
 
-//inline double Population::operator()(unsigned chromosome, unsigned allele) const {
-//    return population[chromosome][allele];
+//template< class Key >
+//inline Key Population< Key >::operator()(unsigned chromosome, unsigned allele) const {
+//    return keys[(size_t)chromosome * stride + allele];
 //}
 
-inline double& Population::operator()(unsigned chromosome, unsigned allele) {
-    return population[chromosome][allele];
+template< class Key >
+inline Key& Population< Key >::operator()(unsigned chromosome, unsigned allele) {
+    return keys[(size_t)slotRow[chromosome] * stride + allele];
+}
+
+template< class Key >
+inline Span< Key > Population< Key >::operator()(unsigned chromosome) {
+    return Span< Key >(keys + (size_t)slotRow[chromosome] * stride, n);
+}
+
+template< class Key >
+inline void Population< Key >::beginGeneration(unsigned pe) {
+    if(spareRows.size() < p - pe) { throw std::range_error("Not enough spare rows for the next generation."); }
+
+    survivors = pe;
+    nextFitness.resize(p);
+    nextSlotRow.resize(p);
+    for(unsigned i = 0; i < pe; ++i) {
+        nextFitness[i] = std::make_pair(fitness[i].first, i);
+        nextSlotRow[i] = slotRow[fitness[i].second];
+    }
+    for(unsigned i = pe; i < p; ++i) { nextSlotRow[i] = spareRows[i - pe]; }
+}
+
+template< class Key >
+inline Span< Key > Population< Key >::getNextChromosome(unsigned i) {
+    return Span< Key >(keys + (size_t)nextSlotRow[i] * stride, n);
+}
+
+template< class Key >
+inline void Population< Key >::setNextFitness(unsigned i, double f) {
+    nextFitness[i].first = f;
+    nextFitness[i].second = i;
+}
+
+template< class Key >
+inline void Population< Key >::endGeneration() {
+    std::swap(fitness, nextFitness);
+    std::swap(slotRow, nextSlotRow);
+    ranked = 0;
+    orderValid = false;
+
+    // spare rows are handed out in increasing order, so offspring are written sequentially
+    usedRows.assign(rows, false);
+    for(unsigned i = 0; i < p; ++i) { usedRows[slotRow[i]] = true; }
+    spareRows.clear();
+    for(unsigned r = 0; r < rows; ++r) {
+        if(!usedRows[r]) { spareRows.push_back(r); }
+    }
+}
+
+/*
+ * Ranking policy of BRKGA: once the fitness of every slot of a population is set, a policy moves its
+ * pe best chromosomes, in order, to the front of the ranking (see Population::rankFitness()). BRKGA
+ * keeps a copy per population, so a policy may keep scratch space of its own. This one ranks by
+ * fitness; MOBRKGA ranks by non-dominated front instead (see ParetoRanking).
+ */
+struct FitnessRanking {
+    template< class Key >
+    void rank(Population< Key >& pop, unsigned pe) { pop.rankFitness(pe); }
+};
+
+//=====================================================================================================================//
+
+// Index of the calling thread inside the current OpenMP team (always 0 without OpenMP)
+inline unsigned getThreadNum() {
+    #ifdef _OPENMP
+        return omp_get_thread_num();
+    #else
+        return 0;
+    #endif
+}
+
+// Overwrites a chromosome with one that picks up and delivers in the order of a good tour of the
+// combined pickup + delivery distances, without relocations (every rearrangement key is ascending).
+// A chromosome of 2n keys encodes the two tours (Decoder::TOURS): the delivery tour is then the
+// pickup tour reversed.
+template< class Key >
+inline void seedWithTSPTour(Span< Key > chromosome) {
+
+    vector < vector < int > > distance;
+    distance.resize(Data::getInstance().numItems+1);
+
+    for(int i = 0; i < Data::getInstance().numItems + 1; ++i) {
+        distance[i].resize(Data::getInstance().numItems + 1);
+        for(int j = 0; j < Data::getInstance().numItems + 1; ++j) {
+            distance[i][j] = Data::getInstance().pickupDistance[i][j] + Data::getInstance().deliveryDistance[i][j];
+        }
+    }
+
+    TSPHeuristic tsp;
+    pair < int, vector < int > > result = tsp.solve(Data::getInstance().numItems+1, distance);
+
+    int k = 0;
+    double allele = 0.0;
+    for(; k < Data::getInstance().numItems; ++k) {
+        chromosome[result.second[k+1] - 1] = KeyTraits< Key >::fromUnit(allele);
+        allele += 0.001;
+    }
+
+    if((int)chromosome.size() == 2 * Data::getInstance().numItems) {
+        for(int i = 0; i < Data::getInstance().numItems; ++i) {
+            chromosome[k + result.second[i+1] - 1] = KeyTraits< Key >::fromUnit(0.001 * (Data::getInstance().numItems - 1 - i));
+        }
+        return;
+    }
+
+    for(int x = 1; x <= Data::getInstance().numItems; ++x) {
+        allele = 0.0;
+        for(int y = 0; y < min(x, Data::getInstance().reloadingDepth + 1); ++y) {
+            chromosome[k] = KeyTraits< Key >::fromUnit(allele);
+            allele += 0.001;
+            k += 1;
+        }
+    }
+
+    for(int x = 1; x <= Data::getInstance().numItems; ++x) {
+        allele = 0.0;
+        for(int y = 0; y < min(Data::getInstance().numItems - x + 1, Data::getInstance().reloadingDepth + 1); ++y) {
+            chromosome[k] = KeyTraits< Key >::fromUnit(allele);
+            allele += 0.001;
+            k += 1;
+        }
+    }
 }
 
-inline std::vector< double >& Population::operator()(unsigned chromosome) {
-    return population[chromosome];
+// Overwrites a LOADING_PLAN chromosome with one that decodes to the given plan: the pickup tour
+// (items only) and, for each of the 2n steps, the rank that every item of the rearranged window
+// takes in it (see Decoder::evaluate). Window item i goes to rank ranks[k][i] when the i-th smallest
+// key of the group is its ranks[k][i]-th one.
+template< class Key >
+inline void encodeLoadingPlan(const vector < int > &pickupTour, const vector < vector < int > > &ranks, Span< Key > chromosome) {
+
+    int k = 0;
+    for(; k < (int)pickupTour.size(); ++k) {
+        chromosome[pickupTour[k] - 1] = KeyTraits< Key >::fromUnit(0.001 * k);
+    }
+
+    for(int step = 0; step < (int)ranks.size(); ++step) {
+        for(int i = 0; i < (int)ranks[step].size(); ++i) {
+            chromosome[k + ranks[step][i]] = KeyTraits< Key >::fromUnit(0.001 * i);
+        }
+        k += ranks[step].size();
+    }
 }
 
 //=====================================================================================================================//
@@ -581,12 +1091,13 @@ inline std::vector< double >& Population::operator()(unsigned chromosome) {
  * BRKGA.h
  *
  * This class encapsulates a Biased Random-key Genetic Algorithm (for minimization problems) with K
- * independent Populations stored in two vectors of Population, current and previous. It supports
+ * independent Populations stored in a vector of Population, current. It supports
  * multi-threading via OpenMP, and implements the following key methods:
  *
  * - BRKGA() constructor: initializes the populations with parameters described below.
  * - evolve() operator: evolve each Population following the BRKGA methodology. This method
- *                      supports OpenMP to evolve up to K independent Populations in parallel.
+ *                      supports OpenMP to evolve up to K independent Populations in parallel,
+ *                      each on its own threads, exchanging elite chromosomes every J generations.
  *                      Please note that double Decoder::decode(...) MUST be thread-safe.
  *
  * Required hyperparameters:
@@ -598,29 +1109,39 @@ inline std::vector< double >& Population::operator()(unsigned chromosome) {
  *
  * Optional parameters:
  * - K: number of independent Populations
- * - MAX_THREADS: number of threads to perform parallel decoding -- WARNING: Decoder::decode() MUST
- *                be thread-safe!
+ * - MAX_THREADS: number of threads to build and decode chromosomes in parallel -- WARNING:
+ *                Decoder::decode() MUST be thread-safe!
  *
  * Required templates are:
  * RNG: random number generator that implements the methods below.
- *     - RNG(unsigned long seed) to initialize a new RNG with 'seed'
- *     - double rand() to return a double precision random deviate in range [0,1)
  *     - unsigned long randInt() to return a >=32-bit unsigned random deviate in range [0,2^32-1)
- *     - unsigned long randInt(N) to return a unsigned random deviate in range [0, N] with N < 2^32
+ *     It is only used once, to seed the PhiloxRNG streams of the framework: every chromosome slot
+ *     of every generation draws from its own stream, keyed by (seed, population, generation, slot),
+ *     so populations are built in parallel and are bit-identical for any MAX_THREADS.
  *
  * Decoder: problem-specific decoder that implements any of the decode methods outlined below. When
  *          compiling and linking BRKGA with -fopenmp (i.e., with multithreading support via
  *          OpenMP), the method must be thread-safe.
- *     - double decode(const vector< double >& chromosome) const, if you don't want to change
+ *     - double decode(Span< const Key > chromosome) const, if you don't want to change
  *       chromosomes inside the framework, or
- *     - double decode(vector< double >& chromosome) const, if you'd like to update a chromosome
+ *     - double decode(Span< Key > chromosome) const, if you'd like to update a chromosome
+ *     Both signatures also receive the index of the calling thread in [0, MAX_THREADS) as a second
+ *     argument, so a decoder can keep per-thread state instead of being fully const, and a cutoff
+ *     as a third one: when the fitness is known to exceed the cutoff, the decoder may stop early and
+ *     return any value greater than it.
+ *     - void decodeBatch(const std::vector< Span< const Key > >& block, std::vector< double >&
+ *       fitness, unsigned threadId, double cutoff), which fills fitness[i] as decode() would for
+ *       block[i]; offspring are decoded in blocks of consecutive slots through it, so a decoder may
+ *       share work between them.
+ *
+ * Ranking: policy that ranks a population by its fitness, FitnessRanking by default (see there).
  *
  *  Created on : Jun 22, 2010 by rtoso
  *  Last update: Sep 28, 2010 by rtoso
  *      Authors: Rodrigo Franco Toso <rtoso@cs.rutgers.edu>
  */
 
-template< class Decoder, class RNG >
+template< class Decoder, class RNG, class Key = double, class Ranking = FitnessRanking >
 class BRKGA {
 public:
     /*
@@ -636,9 +1157,14 @@ public:
      * - K: number of independent Populations
      * - MAX_THREADS: number of threads to perform parallel decoding
      *                WARNING: Decoder::decode() MUST be thread-safe; safe if implemented as
-     *                + double Decoder::decode(std::vector< double >& chromosome) const
+     *                + double Decoder::decode(Span< Key > chromosome) const
+     * - hugePages: back the key matrices with transparent huge pages (Linux only)
+     *
+     * - ranking: ranking policy, copied for each population
+     *
+     * Key is the type used to store each random key: double, float or FixedKey16 (see KeyTraits)
      */
-    BRKGA(unsigned n, unsigned p, double pe, double pm, double rhoe, Decoder& refDecoder, RNG& refRNG, unsigned K = 1, unsigned MAX_THREADS = 1);
+    BRKGA(unsigned n, unsigned p, double pe, double pm, double rhoe, Decoder& refDecoder, RNG& refRNG, unsigned K = 1, unsigned MAX_THREADS = 1, bool hugePages = false, const Ranking& ranking = Ranking());
 
     /**
      * Destructor
@@ -651,12 +1177,15 @@ public:
     void reset();
 
     /**
-     * Evolve the current populations following the guidelines of BRKGAs
-     * @param generations number of generations (must be even and nonzero)
-     * @param J interval to exchange elite chromosomes (must be even; 0 ==> no synchronization)
+     * Evolve the current populations following the guidelines of BRKGAs. With K > 1 and at least K
+     * threads, every population (island) evolves on MAX_THREADS / K threads of its own, and islands
+     * only wait for each other to hand over migrants; otherwise they are evolved one after the
+     * other. Both ways give the same populations.
+     * @param generations number of generations (must be nonzero)
+     * @param J interval to exchange elite chromosomes, counted over all calls (0 ==> no exchange)
      * @param M number of elite chromosomes to select from each population in order to exchange
      */
-    void evolve(unsigned generations = 1);
+    void evolve(unsigned generations = 1, unsigned J = 0, unsigned M = 0);
     
     /**
      * Exchange elite-solutions between the populations
@@ -664,15 +1193,42 @@ public:
      */
     void exchangeElite(unsigned M);
 
+    /**
+     * Decodes the elite of every population again and re-ranks it, for when the decoder's fitness
+     * function has changed. Non-elite chromosomes are left as they are: the next generation
+     * replaces all of them and only uses their fitness to tell them apart from the elite.
+     */
+    void redecodeElite();
+
+    /**
+     * Replaces a non-elite chromosome of every population with a copy of the given one, e.g., a
+     * solution found by another method, decodes it and re-ranks the populations
+     */
+    void inject(Span< const Key > chromosome);
+
+    /**
+     * Improves the 'count' best chromosomes of every population with the decoder's local search,
+     * double Decoder::improve(Span< Key >, unsigned threadId), which writes the improved solution
+     * back into the keys and returns its fitness; then re-ranks the populations. Beyond the elite,
+     * the 'count' best are ranked first.
+     * @param count number of chromosomes to improve in each population (pe for the elite only)
+     */
+    void improve(unsigned count);
+
     /**
      * Returns the current population
      */
-    const Population& getPopulation(unsigned k = 0) const;
+    const Population< Key >& getPopulation(unsigned k = 0) const;
+
+    /**
+     * Returns the ranking policy of a population
+     */
+    const Ranking& getRanking(unsigned k = 0) const;
 
     /**
      * Returns the chromosome with best fitness so far among all populations
      */
-    const std::vector< double >& getBestChromosome() const;
+    Span< const Key > getBestChromosome() const;
 
     /**
      * Returns the best fitness found so far among all populations
@@ -708,21 +1264,52 @@ private:
     const unsigned MAX_THREADS;        // number of threads for parallel decoding
 
     // Data:
-    std::vector< Population* > previous;    // previous populations
-    std::vector< Population* > current;        // current populations
+    std::vector< Population< Key >* > current;        // current populations, each with p - pe spare rows
+    std::vector< Ranking > rankings;                  // ranking policy of each population
+
+    // Random streams:
+    uint64_t streamSeed;            // seed of the stream of every slot, drawn from refRNG
+    unsigned long generation;       // advanced once per initialization or evolution round
+
+    // Scratch blocks filled in bulk by the slot streams, one per thread:
+    std::vector< std::vector< double > > unitBuffers;       // uniform deviates for random keys
+    std::vector< std::vector< uint32_t > > wordBuffers;     // 32-bit words for crossover masks
+    std::vector< std::vector< Span< const Key > > > blockBuffers;    // offspring decoded together
+    std::vector< std::vector< double > > fitnessBuffers;             // and their fitness
+    enum { BLOCK_SIZE = 128 };                              // most offspring per block
+
+    // Island migration: each island posts its M best chromosomes of migration 'e' to its mailbox
+    // e % 2, and announces it in published[k]; consumed[k] is the last migration whose mailboxes
+    // island k has read, so a mailbox is only rewritten once every other island is done with it.
+    unsigned long numEvolutions;                            // generations evolved so far
+    std::vector< std::vector< Key > > mailboxKeys;          // [2 * k + e % 2]: M rows of n keys
+    std::vector< std::vector< double > > mailboxFitness;    // [2 * k + e % 2]: their fitness
+    std::vector< std::atomic< unsigned long > > published;
+    std::vector< std::atomic< unsigned long > > consumed;
 
     // Local operations:
     void initialize(const unsigned i);        // initialize current population 'i' with random keys
-    void evolution(Population& curr, Population& next);
-    bool isRepeated(const std::vector< double >& chrA, const std::vector< double >& chrB) const;
+    void evolution(Population< Key >& pop, const unsigned k,
+            const unsigned numThreads, const unsigned threadBase, const unsigned long g);
+    void evolveIsland(const unsigned k, unsigned generations, unsigned J, unsigned M,
+            const unsigned numThreads, const unsigned threadBase);
+    void migrate(const unsigned k, unsigned M, unsigned long e);    // lock-free exchangeElite for island k
+    PhiloxRNG slotRNG(unsigned k, unsigned slot, unsigned long g) const;    // stream of slot 'slot' of population 'k' in generation 'g'
+    bool isRepeated(Span< const Key > chrA, Span< const Key > chrB) const;
 };
 
-template< class Decoder, class RNG >
-BRKGA< Decoder, RNG >::BRKGA(unsigned _n, unsigned _p, double _pe, double _pm, double _rhoe,
-        Decoder& decoder, RNG& rng, unsigned _K, unsigned MAX) : n(_n), p(_p),
+template< class Decoder, class RNG, class Key, class Ranking >
+BRKGA< Decoder, RNG, Key, Ranking >::BRKGA(unsigned _n, unsigned _p, double _pe, double _pm, double _rhoe,
+        Decoder& decoder, RNG& rng, unsigned _K, unsigned MAX, bool hugePages, const Ranking& ranking) : n(_n), p(_p),
         pe(unsigned(_pe * p)), pm(unsigned(_pm * p)), rhoe(_rhoe),
         refRNG(rng), refDecoder(decoder), K(_K), MAX_THREADS(MAX),
-        previous(K, 0), current(K, 0) {
+        current(K, 0), rankings(K, ranking), generation(0),
+        unitBuffers(std::max(1u, MAX), std::vector< double >(n)),
+        wordBuffers(std::max(1u, MAX), std::vector< uint32_t >(n)),
+        blockBuffers(std::max(1u, MAX)),
+        fitnessBuffers(std::max(1u, MAX)),
+        numEvolutions(0), mailboxKeys(2 * K), mailboxFitness(2 * K),
+        published(K), consumed(K) {
 
     // Error check:
     using std::range_error;
@@ -734,31 +1321,37 @@ BRKGA< Decoder, RNG >::BRKGA(unsigned _n, unsigned _p, double _pe, double _pm, d
     if(pe + pm > p) { throw range_error("elite + mutant sets greater than population size (p)."); }
     if(K == 0) { throw range_error("Number of parallel populations cannot be zero."); }
 
-    // Initialize and decode each chromosome of the current population, then copy to previous:
+    streamSeed = (uint64_t(uint32_t(refRNG.randInt())) << 32) | uint32_t(refRNG.randInt());
+
+    for(unsigned i = 0; i < K; ++i) { published[i].store(0); consumed[i].store(0); }
+
+    // Initialize and decode each chromosome of the current population:
     for(unsigned i = 0; i < K; ++i) {
-        // Allocate:
-        current[i] = new Population(n, p);
+        // Allocate, with room for the offspring of the next generation:
+        current[i] = new Population< Key >(n, p, hugePages, p - pe);
 
         // Initialize:
         initialize(i);
-
-        // Then just copy to previous:
-        previous[i] = new Population(*current[i]);
     }
 }
 
-template< class Decoder, class RNG >
-BRKGA< Decoder, RNG >::~BRKGA() {
-    for(unsigned i = 0; i < K; ++i) { delete current[i]; delete previous[i]; }
+template< class Decoder, class RNG, class Key, class Ranking >
+BRKGA< Decoder, RNG, Key, Ranking >::~BRKGA() {
+    for(unsigned i = 0; i < K; ++i) { delete current[i]; }
 }
 
-template< class Decoder, class RNG >
-const Population& BRKGA< Decoder, RNG >::getPopulation(unsigned k) const {
+template< class Decoder, class RNG, class Key, class Ranking >
+const Population< Key >& BRKGA< Decoder, RNG, Key, Ranking >::getPopulation(unsigned k) const {
     return (*current[k]);
 }
 
-template< class Decoder, class RNG >
-double BRKGA< Decoder, RNG >::getBestFitness() const {
+template< class Decoder, class RNG, class Key, class Ranking >
+const Ranking& BRKGA< Decoder, RNG, Key, Ranking >::getRanking(unsigned k) const {
+    return rankings[k];
+}
+
+template< class Decoder, class RNG, class Key, class Ranking >
+double BRKGA< Decoder, RNG, Key, Ranking >::getBestFitness() const {
     double best = current[0]->fitness[0].first;
     for(unsigned i = 1; i < K; ++i) {
         if(current[i]->fitness[0].first < best) { best = current[i]->fitness[0].first; }
@@ -767,8 +1360,8 @@ double BRKGA< Decoder, RNG >::getBestFitness() const {
     return best;
 }
 
-template< class Decoder, class RNG >
-const std::vector< double >& BRKGA< Decoder, RNG >::getBestChromosome() const {
+template< class Decoder, class RNG, class Key, class Ranking >
+Span< const Key > BRKGA< Decoder, RNG, Key, Ranking >::getBestChromosome() const {
     unsigned bestK = 0;
     for(unsigned i = 1; i < K; ++i) {
         if( current[i]->getBestFitness() < current[bestK]->getBestFitness() ) { bestK = i; }
@@ -777,25 +1370,114 @@ const std::vector< double >& BRKGA< Decoder, RNG >::getBestChromosome() const {
     return current[bestK]->getChromosome(0);    // The top one :-)
 }
 
-template< class Decoder, class RNG >
-void BRKGA< Decoder, RNG >::reset() {
+template< class Decoder, class RNG, class Key, class Ranking >
+void BRKGA< Decoder, RNG, Key, Ranking >::reset() {
+    ++generation;
     for(unsigned i = 0; i < K; ++i) { initialize(i); }
 }
 
-template< class Decoder, class RNG >
-void BRKGA< Decoder, RNG >::evolve(unsigned generations) {
+template< class Decoder, class RNG, class Key, class Ranking >
+void BRKGA< Decoder, RNG, Key, Ranking >::evolve(unsigned generations, unsigned J, unsigned M) {
     if(generations == 0) { throw std::range_error("Cannot evolve for 0 generations."); }
+    if(J > 0 && K > 1 && (M == 0 || M > pe || M * (K - 1) > p - pe)) { throw std::range_error("M must be in [1, pe], and migrants cannot replace elite chromosomes."); }
+
+    bool concurrent = false;
+
+    #ifdef _OPENMP
+        // islands wait for each other at every migration, so this needs a thread per island
+        if(K > 1 && MAX_THREADS >= K && omp_get_active_level() < omp_get_max_active_levels()) {
+            const unsigned threadsPerIsland = MAX_THREADS / K;
+            #pragma omp parallel num_threads(K)
+            {
+                if(omp_get_num_threads() == int(K)) {
+                    const unsigned k = omp_get_thread_num();
+                    evolveIsland(k, generations, J, M, threadsPerIsland, k * threadsPerIsland);
+                    if(k == 0) { concurrent = true; }
+                }
+            }
+        }
+    #endif
+
+    if(concurrent) {
+        numEvolutions += generations;
+        generation += generations;
+        return;
+    }
 
     for(unsigned i = 0; i < generations; ++i) {
+        ++generation;
         for(unsigned j = 0; j < K; ++j) {
-            evolution(*current[j], *previous[j]);    // First evolve the population (curr, next)
-            std::swap(current[j], previous[j]);        // Update (prev = curr; curr = prev == next)
+            evolution(*current[j], j, MAX_THREADS, 0, generation);
+        }
+        ++numEvolutions;
+        if(J > 0 && K > 1 && numEvolutions % J == 0) {
+            exchangeElite(M);
+            for(unsigned j = 0; j < K; ++j) {
+                published[j].store(numEvolutions / J);
+                consumed[j].store(numEvolutions / J);
+            }
         }
     }
 }
 
-template< class Decoder, class RNG >
-void BRKGA< Decoder, RNG >::exchangeElite(unsigned M) {
+// Evolves island k for the given generations on threads [threadBase, threadBase + numThreads), while
+// the other islands are evolved by other threads
+template< class Decoder, class RNG, class Key, class Ranking >
+void BRKGA< Decoder, RNG, Key, Ranking >::evolveIsland(const unsigned k, unsigned generations, unsigned J, unsigned M,
+        const unsigned numThreads, const unsigned threadBase) {
+
+    for(unsigned i = 0; i < generations; ++i) {
+        // slot streams are keyed by the generation, which this island's thread advances on its own
+        const unsigned long g = generation + i + 1;
+        evolution(*current[k], k, numThreads, threadBase, g);
+        if(J > 0 && (numEvolutions + i + 1) % J == 0) {
+            migrate(k, M, (numEvolutions + i + 1) / J);
+        }
+    }
+}
+
+// Island k's part of the e-th exchange: posts its M best chromosomes, then takes the M best of every
+// other island, in increasing island order, into its last-ranked (non-elite) slots, exactly as
+// exchangeElite(M) does
+template< class Decoder, class RNG, class Key, class Ranking >
+void BRKGA< Decoder, RNG, Key, Ranking >::migrate(const unsigned k, unsigned M, unsigned long e) {
+
+    Population< Key >& pop = *current[k];
+    const unsigned box = 2 * k + e % 2;
+
+    // the mailbox was last read during exchange e - 2
+    for(unsigned j = 0; j < K; ++j) {
+        while(j != k && consumed[j].load(std::memory_order_acquire) + 2 < e) { std::this_thread::yield(); }
+    }
+
+    mailboxKeys[box].resize(M * n);
+    mailboxFitness[box].resize(M);
+    for(unsigned m = 0; m < M; ++m) {
+        Span< const Key > best = pop.getChromosome(m);
+        std::copy(best.begin(), best.end(), mailboxKeys[box].begin() + m * n);
+        mailboxFitness[box][m] = pop.fitness[m].first;
+    }
+    published[k].store(e, std::memory_order_release);
+
+    unsigned dest = p - 1;
+    for(unsigned j = 0; j < K; ++j) {
+        if(j == k) { continue; }
+        while(published[j].load(std::memory_order_acquire) < e) { std::this_thread::yield(); }
+
+        const unsigned from = 2 * j + e % 2;
+        for(unsigned m = 0; m < M; ++m) {
+            std::copy(mailboxKeys[from].begin() + m * n, mailboxKeys[from].begin() + (m + 1) * n, pop.getChromosome(dest).begin());
+            pop.fitness[dest].first = mailboxFitness[from][m];
+            --dest;
+        }
+    }
+    consumed[k].store(e, std::memory_order_release);
+
+    rankings[k].rank(pop, pe);
+}
+
+template< class Decoder, class RNG, class Key, class Ranking >
+void BRKGA< Decoder, RNG, Key, Ranking >::exchangeElite(unsigned M) {
     if(M == 0 || M >= p) { throw std::range_error("M cannot be zero or >= p."); }
 
     for(unsigned i = 0; i < K; ++i) {
@@ -807,7 +1489,7 @@ void BRKGA< Decoder, RNG >::exchangeElite(unsigned M) {
             // Copy the M best of Population j into Population i:
             for(unsigned m = 0; m < M; ++m) {
                 // Copy the m-th best of Population j into the 'dest'-th position of Population i:
-                const std::vector< double >& bestOfJ = current[j]->getChromosome(m);
+                Span< const Key > bestOfJ = current[j]->getChromosome(m);
 
                 std::copy(bestOfJ.begin(), bestOfJ.end(), current[i]->getChromosome(dest).begin());
 
@@ -818,150 +1500,194 @@ void BRKGA< Decoder, RNG >::exchangeElite(unsigned M) {
         }
     }
 
-    for(int j = 0; j < int(K); ++j) { current[j]->sortFitness(); }
+    for(int j = 0; j < int(K); ++j) { rankings[j].rank(*current[j], pe); }
 }
 
-template< class Decoder, class RNG >
-inline void BRKGA< Decoder, RNG >::initialize(const unsigned i) {
+template< class Decoder, class RNG, class Key, class Ranking >
+void BRKGA< Decoder, RNG, Key, Ranking >::redecodeElite() {
+    for(unsigned k = 0; k < K; ++k) {
+        Population< Key >& pop = *current[k];
+
+        #ifdef _OPENMP
+            #pragma omp parallel for num_threads(MAX_THREADS)
+        #endif
+        for(int i = 0; i < int(pe); ++i) {
+            pop.fitness[i].first = refDecoder.decode(pop.getChromosome(i), getThreadNum());
+        }
 
-    for(unsigned j = 0; j < p; ++j) {
-        for(unsigned k = 0; k < n; ++k) { (*current[i])(j, k) = refRNG.rand(); }
+        std::sort(pop.fitness.begin(), pop.fitness.begin() + pe);
+        pop.ranked = pe;
+        pop.orderValid = false;
     }
+}
 
-    vector < vector < int > > distance;
-    distance.resize(Data::getInstance().numItems+1);
+template< class Decoder, class RNG, class Key, class Ranking >
+void BRKGA< Decoder, RNG, Key, Ranking >::inject(Span< const Key > chromosome) {
+    for(unsigned k = 0; k < K; ++k) {
+        Population< Key >& pop = *current[k];
 
-    for(int i = 0; i < Data::getInstance().numItems + 1; ++i) {
-        distance[i].resize(Data::getInstance().numItems + 1);
-        for(int j = 0; j < Data::getInstance().numItems + 1; ++j) {
-            distance[i][j] = Data::getInstance().pickupDistance[i][j] + Data::getInstance().deliveryDistance[i][j];
-        }
+        Span< Key > slot = pop.getChromosome(p - 1);
+        std::copy(chromosome.begin(), chromosome.end(), slot.begin());
+        pop.fitness[p - 1].first = refDecoder.decode(slot, 0);
+
+        rankings[k].rank(pop, pe);
     }
+}
 
-    TSPSolver tsp;
-    pair < int, vector < int > > result = tsp.solve(Data::getInstance().numItems+1, distance);
+template< class Decoder, class RNG, class Key, class Ranking >
+void BRKGA< Decoder, RNG, Key, Ranking >::improve(unsigned count) {
+    if(count > p) { count = p; }
 
-    int k = 0;
-    double allele = 0.0;
-    for(; k < Data::getInstance().numItems; ++k) {
-        (*current[i])(0, result.second[k+1] - 1) = allele;
-        allele += 0.001;
-    }
+    for(unsigned k = 0; k < K; ++k) {
+        Population< Key >& pop = *current[k];
 
-    for(int x = 1; x <= Data::getInstance().numItems; ++x) {
-        allele = 0.0;
-        for(int y = 0; y < min(x, Data::getInstance().reloadingDepth + 1); ++y) {
-            (*current[i])(0, k) = allele;
-            allele += 0.001;
-            k += 1;
-        }
-    }
-    
-    for(int x = 1; x <= Data::getInstance().numItems; ++x) {
-        allele = 0.0;
-        for(int y = 0; y < min(Data::getInstance().numItems - x + 1, Data::getInstance().reloadingDepth + 1); ++y) {
-            (*current[i])(0, k) = allele;
-            allele += 0.001;
-            k += 1;
+        // Only ranked slots are improved: past the elite, the first 'count' slots are in no order
+        if(count > pop.ranked) { rankings[k].rank(pop, count); }
+
+        #ifdef _OPENMP
+            #pragma omp parallel for schedule(dynamic) num_threads(MAX_THREADS)
+        #endif
+        for(int i = 0; i < int(count); ++i) {
+            pop.fitness[i].first = refDecoder.improve(pop.getChromosome(i), getThreadNum());
         }
+
+        pop.orderValid = false;
+        rankings[k].rank(pop, pe);
     }
-    
-    // Decode:
+}
+
+template< class Decoder, class RNG, class Key, class Ranking >
+inline void BRKGA< Decoder, RNG, Key, Ranking >::initialize(const unsigned i) {
+
     #ifdef _OPENMP
         #pragma omp parallel for num_threads(MAX_THREADS)
     #endif
     for(int j = 0; j < int(p); ++j) {
-        current[i]->setFitness(j, refDecoder.decode((*current[i])(j)) );
+        std::vector< double >& units = unitBuffers[getThreadNum()];
+        slotRNG(i, j, generation).fill(units.data(), n);
+        for(unsigned k = 0; k < n; ++k) { (*current[i])(j, k) = KeyTraits< Key >::fromUnit(units[k]); }
     }
 
-    // Sort:
-    current[i]->sortFitness();
-}
-
-template< class Decoder, class RNG >
-inline void BRKGA< Decoder, RNG >::evolution(Population& curr, Population& next) {
-    // We now will set every chromosome of 'current', iterating with 'i':
-    unsigned i = 0;    // Iterate chromosome by chromosome
-    unsigned j = 0;    // Iterate allele by allele
+    seedWithTSPTour((*current[i])(0));
 
-    // 2. The 'pe' best chromosomes are maintained, so we just copy these into 'current':
-    while(i < pe) {
-        for(j = 0 ; j < n; ++j) { next(i,j) = curr(curr.fitness[i].second, j); }
-
-        next.fitness[i].first = curr.fitness[i].first;
-        next.fitness[i].second = i;
-        ++i;
+    // Decode:
+    #ifdef _OPENMP
+        #pragma omp parallel for num_threads(MAX_THREADS)
+    #endif
+    for(int j = 0; j < int(p); ++j) {
+        current[i]->setFitness(j, refDecoder.decode((*current[i])(j), getThreadNum()) );
     }
 
-    // 3. We'll mate 'p - pe - pm' pairs; initially, i = pe, so we need to iterate until i < p - pm:
-    while(i < p - pm) {
-        // Select an elite parent:
-        const unsigned eliteParent = (refRNG.randInt(pe - 1));
+    // Rank:
+    rankings[i].rank(*current[i], pe);
+}
 
-        // Select a non-elite parent:
-        const unsigned noneliteParent = pe + (refRNG.randInt(p - pe - 1));
+template< class Decoder, class RNG, class Key, class Ranking >
+inline PhiloxRNG BRKGA< Decoder, RNG, Key, Ranking >::slotRNG(unsigned k, unsigned slot, unsigned long g) const {
+    return PhiloxRNG(streamSeed + k, (uint64_t(g) << 32) | slot);
+}
 
-        // Mate:
-        for(j = 0; j < n; ++j) {
-            const unsigned sourceParent = ((refRNG.rand() < rhoe) ? eliteParent : noneliteParent);
+template< class Decoder, class RNG, class Key, class Ranking >
+inline void BRKGA< Decoder, RNG, Key, Ranking >::evolution(Population< Key >& pop, const unsigned k,
+        const unsigned numThreads, const unsigned threadBase, const unsigned long g) {
+    // An offspring inherits allele j from its elite parent when the j-th random word of its mask is
+    // below rhoe * 2^32, which lets a whole mask be drawn and applied without branches:
+    const uint32_t inheritThreshold = (rhoe >= 1.0) ? UINT32_MAX : uint32_t(rhoe * 4294967296.0);
+
+    // Offspring worse than the worst elite of 'curr' cannot enter the elite of 'next', and the exact
+    // rank of a non-elite chromosome does not matter, so their decoding may stop at this cutoff:
+    const double eliteCutoff = pop.fitness[pe - 1].first;
+
+    // 2. The 'pe' best chromosomes are maintained: they keep their rows and fitness as the first
+    // slots of the next generation, whose other slots are built in the spare rows:
+    pop.beginGeneration(pe);
+
+    // Every other slot 'i' of the next generation is built from the current one and its own random
+    // stream only, so slots are independent of each other and of the thread that handles them. They
+    // are built and decoded in blocks of consecutive slots, which the decoder may decode together
+    // (see Decoder::decodeBatch()); blocks are kept small enough to stay in cache and to give every
+    // thread some:
+    const unsigned blockSize = std::max(16u, std::min(unsigned(BLOCK_SIZE), (p - pe) / (4 * numThreads)));
+    const int numBlocks = (p - pe + blockSize - 1) / blockSize;
 
-            next(i, j) = curr(curr.fitness[sourceParent].second, j);
+    #ifdef _OPENMP
+        #pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+    #endif
+    for(int b = 0; b < numBlocks; ++b) {
+        const unsigned threadId = threadBase + getThreadNum();
+        const int first = int(pe + b * blockSize);
+        const int last = std::min(int(p), first + int(blockSize));
+        std::vector< Span< const Key > >& block = blockBuffers[threadId];
+        block.clear();
+
+        for(int i = first; i < last; ++i) {
+            PhiloxRNG rng = slotRNG(k, i, g);
+            Key* offspring = pop.getNextChromosome(i).data();
+
+            if(i < int(p - pm)) {
+                // 3. Mate an elite parent with a non-elite one:
+                const unsigned eliteParent = rng.randInt(pe - 1);
+                const unsigned noneliteParent = pe + rng.randInt(p - pe - 1);
+
+                const Key* elite = pop.getChromosome(eliteParent).data();
+                const Key* nonelite = pop.getChromosome(noneliteParent).data();
+                const uint32_t* mask = wordBuffers[threadId].data();
+                rng.fillBits(wordBuffers[threadId].data(), n);
+                for(unsigned j = 0; j < n; ++j) {
+                    offspring[j] = (mask[j] < inheritThreshold) ? elite[j] : nonelite[j];
+                }
+            }
+            else {
+                // 4. Introduce a mutant:
+                const double* units = unitBuffers[threadId].data();
+                rng.fill(unitBuffers[threadId].data(), n);
+                for(unsigned j = 0; j < n; ++j) { offspring[j] = KeyTraits< Key >::fromUnit(units[j]); }
+            }
 
-            //next(i, j) = (refRNG.rand() < rhoe) ? curr(curr.fitness[eliteParent].second, j) :
-            //                                      curr(curr.fitness[noneliteParent].second, j);
+            block.push_back(pop.getNextChromosome(i));
         }
 
-        ++i;
-    }
-
-    // We'll introduce 'pm' mutants:
-    while(i < p) {
-        for(j = 0; j < n; ++j) { next(i, j) = refRNG.rand(); }
-        ++i;
+        std::vector< double >& blockFitness = fitnessBuffers[threadId];
+        refDecoder.decodeBatch(block, blockFitness, threadId, eliteCutoff);
+        for(int i = first; i < last; ++i) { pop.setNextFitness(i, blockFitness[i - first]); }
     }
 
-    // Time to compute fitness, in parallel:
-    #ifdef _OPENMP
-        #pragma omp parallel for num_threads(MAX_THREADS)
-    #endif
-    for(int i = int(pe); i < int(p); ++i) {
-        next.setFitness( i, refDecoder.decode(next.population[i]) );
-    }
-
-    // Now we must sort 'current' by fitness, since things might have changed:
-    next.sortFitness();
+    // Now we must rank the new generation by fitness, since things might have changed; only its
+    // elite needs an order, as non-elite parents are drawn uniformly:
+    pop.endGeneration();
+    rankings[k].rank(pop, pe);
 }
 
-template< class Decoder, class RNG >
-unsigned BRKGA<Decoder, RNG>::getN() const { return n; }
+template< class Decoder, class RNG, class Key, class Ranking >
+unsigned BRKGA< Decoder, RNG, Key, Ranking >::getN() const { return n; }
 
-template< class Decoder, class RNG >
-unsigned BRKGA<Decoder, RNG>::getP() const { return p; }
+template< class Decoder, class RNG, class Key, class Ranking >
+unsigned BRKGA< Decoder, RNG, Key, Ranking >::getP() const { return p; }
 
-template< class Decoder, class RNG >
-unsigned BRKGA<Decoder, RNG>::getPe() const { return pe; }
+template< class Decoder, class RNG, class Key, class Ranking >
+unsigned BRKGA< Decoder, RNG, Key, Ranking >::getPe() const { return pe; }
 
-template< class Decoder, class RNG >
-unsigned BRKGA<Decoder, RNG>::getPm() const { return pm; }
+template< class Decoder, class RNG, class Key, class Ranking >
+unsigned BRKGA< Decoder, RNG, Key, Ranking >::getPm() const { return pm; }
 
-template< class Decoder, class RNG >
-unsigned BRKGA<Decoder, RNG>::getPo() const { return p - pe - pm; }
+template< class Decoder, class RNG, class Key, class Ranking >
+unsigned BRKGA< Decoder, RNG, Key, Ranking >::getPo() const { return p - pe - pm; }
 
-template< class Decoder, class RNG >
-double BRKGA<Decoder, RNG>::getRhoe() const { return rhoe; }
+template< class Decoder, class RNG, class Key, class Ranking >
+double BRKGA< Decoder, RNG, Key, Ranking >::getRhoe() const { return rhoe; }
 
-template< class Decoder, class RNG >
-unsigned BRKGA<Decoder, RNG>::getK() const { return K; }
+template< class Decoder, class RNG, class Key, class Ranking >
+unsigned BRKGA< Decoder, RNG, Key, Ranking >::getK() const { return K; }
 
-template< class Decoder, class RNG >
-unsigned BRKGA<Decoder, RNG>::getMAX_THREADS() const { return MAX_THREADS; }
+template< class Decoder, class RNG, class Key, class Ranking >
+unsigned BRKGA< Decoder, RNG, Key, Ranking >::getMAX_THREADS() const { return MAX_THREADS; }
 
 //=====================================================================================================================//
 
 /*
  * Decoder.h
  *
- * Any decoder must have the format below, i.e., implement the method decode(std::vector< double >&)
+ * Any decoder must have the format below, i.e., implement the method decode(Span< const double >)
  * returning a double corresponding to the fitness of that vector. If parallel decoding is to be
  * used in the BRKGA framework, then the decode() method _must_ be thread-safe; the best way to
  * guarantee this is by adding 'const' to the end of decode() so that the property will be checked
@@ -978,18 +1704,203 @@ unsigned BRKGA<Decoder, RNG>::getMAX_THREADS() const { return MAX_THREADS; }
 class Decoder {
 
 public:
-    
+
+    // What the chromosome encodes. LOADING_PLAN: the pickup tour and every rearrangement (n plus
+    // up to 2n(l+1) keys). TOURS: only the pickup tour and the delivery tour (2n keys), the loading
+    // plan being chosen by planTours()
+    enum Encoding { LOADING_PLAN, TOURS };
+
     double alpha;
     double beta;
     
-    NonDominatedSet nds;
+    NonDominatedSet nds;    // archive of every decoded solution, as of the last mergeArchives()
+
+    // Best solution found so far for each relocation cost passed to trackRelocationCosts(), as of
+    // the last mergeArchives(); keys are stored as doubles in [0,1), which decode the same way
+    std::vector< int > trackedCosts;
+    std::vector< double > incumbentCost;
+    std::vector< std::vector< double > > incumbentKeys;
     
-    Decoder(double _alpha=1.0, double _beta=1.0);
+    // cacheCapacity is the number of decoded solutions kept by the solution cache (0 disables it);
+    // beamWidth is the number of container states planTours() keeps per step (0 keeps them all)
+    Decoder(double _alpha=1.0, double _beta=1.0, unsigned _numThreads=1, unsigned long cacheCapacity=0, Encoding _encoding=LOADING_PLAN, unsigned _beamWidth=4);
         
     ~Decoder();
 
-    double decode(const std::vector< double >& chromosome, string solutionFileOut = "");
-    
+    int getChromosomeSize() const;
+
+    // threadId selects the scratch workspace, so concurrent calls must use distinct ids. Decoding
+    // stops as soon as the partial cost exceeds cutoff, in which case INF is returned.
+    // Chromosome may be a Span or a std::vector of any key type supported by KeyTraits
+    template< class Chromosome >
+    double decode(const Chromosome& chromosome, unsigned threadId = 0, double cutoff = INF) {
+        typedef typename Chromosome::value_type Key;
+        return decodeKeys(Span< const Key >(chromosome.data(), chromosome.size()), threadId, cutoff);
+    }
+
+    // Decodes a block of chromosomes into fitness, as decode() would one by one with the same cutoff,
+    // but simulates the loading plan only once for the steps that chromosomes share at the start of
+    // their decoding (see decodeBatchKeys())
+    template< class Key >
+    void decodeBatch(const std::vector< Span< const Key > >& chromosomes, std::vector< double >& fitness, unsigned threadId = 0, double cutoff = INF) {
+        decodeBatchKeys(chromosomes, fitness, threadId, cutoff);
+    }
+
+    // Distance traveled and number of relocations of the chromosome, which is always fully decoded
+    template< class Chromosome >
+    std::pair< int, int > decodeObjectives(const Chromosome& chromosome, unsigned threadId = 0) {
+        typedef typename Chromosome::value_type Key;
+        return decodeObjectivesKeys(Span< const Key >(chromosome.data(), chromosome.size()), threadId);
+    }
+
+    // Local search on the decoded solution: swaps two pickups, or two choices of one rearrangement,
+    // while that lowers the fitness, and writes the result back into the keys. Returns the fitness
+    // of the new keys, which are decoded (and archived) like in decode(). Moves are priced from the
+    // plan of the current keys alone (see improveKeys()). With TOURS, swaps two consecutive stops
+    // of either tour instead, each priced by decoding (see improveTours()).
+    template< class Key >
+    double improve(Span< Key > chromosome, unsigned threadId = 0) {
+        return improveKeys(chromosome, threadId);
+    }
+
+    template< class Chromosome >
+    void saveSolution(const Chromosome& chromosome, const string solutionFileOut) {
+        typedef typename Chromosome::value_type Key;
+        saveSolutionKeys(Span< const Key >(chromosome.data(), chromosome.size()), solutionFileOut);
+    }
+
+    // Containers after each pickup and before each delivery of the decoded solution, bottom first,
+    // as in the timeline of saveSolution()
+    template< class Chromosome >
+    vector < vector < int > > decodeTimeline(const Chromosome& chromosome, unsigned threadId = 0) {
+        typedef typename Chromosome::value_type Key;
+        return decodeTimelineKeys(Span< const Key >(chromosome.data(), chromosome.size()), threadId);
+    }
+
+    // Relocation cost h of the fitness alpha * distance + beta * h * relocations; Data's by default.
+    // With TOURS it also empties the solution cache, so it must not be called while decoding
+    void setRelocationCost(int h);
+    int getRelocationCost() const;
+
+    // Keeps, besides the fitness, the best solution for each of these relocation costs. Any solution
+    // may then be the best one for some cost, or a point of the front in nds, so decoding no longer
+    // stops at the cutoff
+    void trackRelocationCosts(const std::vector< int >& costs);
+
+    // Moves the per-thread archives and incumbents into nds and incumbent*; must not run
+    // concurrently with decode()
+    void mergeArchives();
+
+    // Solution cache counters, summed over threads; must not run concurrently with decode()
+    long long getCacheLookups() const;
+    long long getCacheHits() const;
+
+private:
+
+    // A container state kept by planTours(): the delivery distance and relocations so far, the
+    // deliveries that left the delivery tour, and the last position delivered. Its priority is the
+    // cost once completed by completeGreedily(), only needed when a step keeps beamWidth of them.
+    // move is the first window entry its step sorted.
+    struct BeamState {
+        double cost;
+        double priority;
+        uint64_t hash;
+        int distance;
+        int relocations;
+        int deviations;
+        int priorityDeviations;
+        int last;
+        int parent;
+        int move;
+    };
+
+    // Scratch buffers reused by every decode() call of one thread
+    struct Workspace {
+        std::vector< std::pair< double, int > > keys;    // sorted key groups, laid out as groupOffset
+        std::vector< std::pair< int, int > > window;     // items rearranged at the current step
+        std::vector< int > stack;
+        std::vector< int > pickupTour;
+        std::vector< int > deliveryTour;
+        std::vector< int > stepItems;                    // items entering each rearrangement, as groupOffset
+        std::vector< int > deliveryPosition;             // of each item in deliveryTour
+        std::vector< int > batchSteps;                   // decoded steps of each chromosome of a batch
+        std::vector< int > batchPickupDistance;
+        std::vector< unsigned > batchOrder;
+        std::vector< uint64_t > batchHash;               // cache key of each chromosome of a batch
+        std::vector< int > undo;                         // stack entries each step overwrote, as groupOffset
+        std::vector< int > stepTop;                      // state after each step of the last decoding
+        std::vector< int > stepRelocations;
+        std::vector< int > stepDistance;                 // delivery distance only
+        std::vector< int > stepLast;                     // last item delivered
+        std::vector< int > pickupPositions;              // delivery positions in pickup order (TOURS)
+        std::vector< int > tourWindow;
+        std::vector< int > tourSorted;
+        std::vector< int > rollout;
+        std::vector< int > keyOrder;                     // of a group, as improveTours() swaps it
+        std::vector< int > beamStacks;                   // container of every kept state, n entries each
+        std::vector< int > candidateStacks;              // and of every successor
+        std::vector< BeamState > beamStates;
+        std::vector< BeamState > candidates;
+        std::vector< int > candidateOrder;
+        std::vector< std::pair< int, int > > beamMoves;  // (parent, move) of the states kept at every step
+        NonDominatedSet nds;                             // solutions decoded by this thread
+        long long cacheLookups;
+        long long cacheHits;
+        std::vector< double > incumbentCost;                  // per tracked relocation cost
+        std::vector< std::vector< double > > incumbentKeys;
+        std::vector< double > unitKeys;                  // of the chromosome updateIncumbents() records
+    };
+
+    // Rearrangement groups hold at most depth + 1 keys, with depth = min(l, n - 1). Up to this depth
+    // the decoder is specialised at compile time: groups are sorted by sorting networks and the
+    // rearranged window of the stack is placed directly by rank. Deeper windows use GENERIC_DEPTH.
+    enum { GENERIC_DEPTH = -1, MAX_FIXED_DEPTH = 5 };
+
+    int n;
+    int l;
+    int depth;    // depth of the specialised decoder in use, or GENERIC_DEPTH
+    int relocationCost;
+    Encoding encoding;
+    unsigned beamWidth;
+    std::vector< int > groupOffset;    // first key of each of the 2n+1 key groups (plus the end)
+    std::vector< int > stepStart;      // first token of each step in decodeBatch() (plus the end)
+    std::vector< Workspace > workspaces;
+    SolutionCache cache;    // decoded solutions, keyed by the hash of the ranks of every group
+
+    template< class Key >
+    bool decodeSolution(Span< const Key > chromosome, unsigned threadId, double cutoff, int& distance, int& numberOfRelocations);
+    template< class Key, int Depth >
+    bool decodeSolutionDepth(Span< const Key > chromosome, unsigned threadId, double cutoff, int& distance, int& numberOfRelocations);
+    template< class Key >
+    double decodeKeys(Span< const Key > chromosome, unsigned threadId, double cutoff);
+    template< class Key >
+    std::pair< int, int > decodeObjectivesKeys(Span< const Key > chromosome, unsigned threadId);
+    template< class Key >
+    void saveSolutionKeys(Span< const Key > chromosome, const string solutionFileOut);
+    template< class Key >
+    vector < vector < int > > decodeTimelineKeys(Span< const Key > chromosome, unsigned threadId);
+    template< class Key >
+    double improveKeys(Span< Key > chromosome, unsigned threadId);
+    template< class Key >
+    void decodeBatchKeys(const std::vector< Span< const Key > >& chromosomes, std::vector< double >& fitness, unsigned threadId, double cutoff);
+    template< class Key >
+    void buildPlan(Span< const Key > chromosome, Workspace& ws, int& distance, int& numberOfRelocations);
+    template< class Key, int Depth >
+    void sortGroup(Span< const Key > chromosome, Workspace& ws, int g);
+    template< class Key >
+    void updateIncumbents(Span< const Key > chromosome, Workspace& ws, int distance, int numberOfRelocations);
+    template< class Key, int Depth >
+    uint64_t sortAllGroups(Span< const Key > chromosome, Workspace& ws);
+    template< class Key >
+    bool evaluate(Span< const Key > chromosome, Workspace& ws, int& distance, int& numberOfRelocations, double cutoff, vector < vector < int > >* timeline = NULL, bool groupsSorted = false);
+    template< class Key, int Depth >
+    bool evaluateFixed(Span< const Key > chromosome, Workspace& ws, int& distance, int& numberOfRelocations, double cutoff, vector < vector < int > >* timeline, bool groupsSorted);
+    template< class Key >
+    bool evaluateTours(Span< const Key > chromosome, Workspace& ws, int& distance, int& numberOfRelocations, double cutoff, vector < vector < int > >* timeline, bool groupsSorted);
+    template< class Key >
+    double improveTours(Span< Key > chromosome, unsigned threadId);
+    bool planTours(Workspace& ws, int& distance, int& numberOfRelocations, double cutoff, vector < vector < int > >* timeline);
+    double completeGreedily(Workspace& ws, const int* stack, int top, int step, int last, int& deviations) const;
 };
 
 #endif
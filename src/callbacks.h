@@ -2,9 +2,11 @@
 #define LOG_CALLBACK_H
 
 #include "gurobi_c++.h"
+#include <cmath>
 #include <string>
 
 #include "non_dominated_set.h"
+#include "solution_exchange.h"
 
 class LogCallback: public GRBCallback {
 
@@ -56,4 +58,55 @@ class LogCallback: public GRBCallback {
             }
 };
 
+// LogCallback of a HYBRID run: also posts every new incumbent and the bound of the MIP to the
+// exchange and, at the nodes, hands the MIP the better plans the BRKGA posted. Formulation provides the variables that
+// describe a plan and the conversions between their values and plans.
+template< class Formulation >
+class ExchangeCallback: public LogCallback {
+
+    public:
+
+            Formulation &formulation;
+            SolutionExchange &exchange;
+            vector < GRBVar > planVariables;
+
+            ExchangeCallback(GRBVar &_f1, GRBVar &_f2, Formulation &_formulation, SolutionExchange &_exchange) :
+                    LogCallback(_f1, _f2), formulation(_formulation), exchange(_exchange) {
+                planVariables = formulation.getPlanVariables();
+            }
+
+    protected:
+
+            void callback () {
+
+                LogCallback::callback();
+
+                try {
+                    if (where == GRB_CB_MIP) {
+                        double objbnd = getDoubleInfo(GRB_CB_MIP_OBJBND);
+                        if(objbnd > 0 && objbnd < INF) exchange.postBound((int)ceil(objbnd - EPS));
+                    }
+                    if (where == GRB_CB_MIPSOL) {
+                        double *values = getSolution(planVariables.data(), planVariables.size());
+                        LoadingPlan plan = formulation.planFromValues(values);
+                        delete[] values;
+                        if(!plan.pickupTour.empty()) exchange.postFromILP(plan);
+                    }
+                    if (where == GRB_CB_MIPNODE) {
+                        LoadingPlan plan;
+                        if(exchange.takeForILP(plan)) {
+                            vector < double > values = formulation.valuesFromPlan(plan);
+                            setSolution(planVariables.data(), values.data(), planVariables.size());
+                        }
+                    }
+                }
+                catch (GRBException e) {
+                    clog << "Error number: " << e.getErrorCode() << endl;
+                    clog << e.getMessage() << endl;
+                } catch (...) {
+                    clog << "Error during callback" << endl;
+                }
+            }
+};
+
 #endif
@@ -0,0 +1,231 @@
+#ifndef EXACT_SOLVER_H
+#define EXACT_SOLVER_H
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "data.h"
+#include "loading_plan.h"
+#include "tsp_solver.h"
+
+using namespace std;
+
+// Exact procedures for the parameters under which the problem degenerates:
+// - LIFO (l = 0): nothing can be rearranged, so items are delivered in the reverse pickup order and
+//   a solution is a single tour of the combined distances;
+// - SPLIT_TOURS (h = 0 and l >= n - 1): the whole container can be rearranged for free, so an
+//   optimal pickup tour and an optimal delivery tour can always be combined;
+// - SMALL_INSTANCE (n <= MAX_SMALL_ITEMS): dynamic program over every container the plan can
+//   leave after each step, with the last stop visited.
+// The TSPs are solved by TSPSolver, exactly. The decoder and the ILP formulations charge a
+// rearrangement differently (see RelocationCounting), so the optimal plan depends on whose cost it
+// minimizes.
+
+class ExactSolver {
+
+    private:
+
+            // a state of the dynamic program: the cost to reach it, and how
+            struct State {
+                int cost;
+                int distance;
+                int relocations;
+                int parent;    // index in the previous step
+                int item;      // picked up at this step
+                int ranks;     // of the window, one octal digit each
+            };
+
+            int numThreads;
+            RelocationCounting counting;
+
+            int relocations(const int* ranks, int g) const {
+                return countRelocations(ranks, g, counting);
+            }
+
+            static vector < int > identity(int g) {
+                vector < int > ranks(g);
+                for(int i = 0; i < g; ++i) ranks[i] = i;
+                return ranks;
+            }
+
+            LoadingPlan solveLIFO() {
+
+                const int n = Data::getInstance().numItems;
+
+                // the delivery tour runs the pickup tour backwards (both are symmetric, and so is
+                // their sum)
+                vector < vector < int > > distance(n + 1, vector < int > (n + 1));
+                for(int u = 0; u <= n; ++u) {
+                    for(int v = 0; v <= n; ++v) distance[u][v] = Data::getInstance().pickupDistance[u][v] + Data::getInstance().deliveryDistance[v][u];
+                }
+
+                LoadingPlan plan;
+                pair < int, vector < int > > tour = TSPSolver(numThreads).solve(n + 1, distance);
+                if(tour.second.empty()) return plan;
+
+                plan.pickupTour.assign(tour.second.begin() + 1, tour.second.begin() + n + 1);
+                plan.ranks.assign(2 * n, vector < int > (1, 0));
+                plan.distance = tour.first;
+                plan.relocations = 0;
+                return plan;
+            }
+
+            // The last pickup sorts the whole container in the order of the delivery tour, which is
+            // then followed without relocations
+            LoadingPlan solveSplitTours() {
+
+                const int n = Data::getInstance().numItems;
+
+                LoadingPlan plan;
+                pair < int, vector < int > > pickupResult = TSPSolver(numThreads).solve(n + 1, Data::getInstance().pickupDistance);
+                pair < int, vector < int > > deliveryResult = TSPSolver(numThreads).solve(n + 1, Data::getInstance().deliveryDistance);
+                if(pickupResult.second.empty() || deliveryResult.second.empty()) return plan;
+
+                vector < int > deliveryPosition(n + 1);
+                for(int d = 1; d <= n; ++d) deliveryPosition[deliveryResult.second[d]] = d;
+
+                plan.pickupTour.assign(pickupResult.second.begin() + 1, pickupResult.second.begin() + n + 1);
+                for(int k = 1; k < n; ++k) plan.ranks.push_back(identity(k));
+
+                // window of the last pickup: the new item, then the others from the top
+                vector < int > last(n);
+                for(int i = 0; i < n; ++i) last[i] = deliveryPosition[plan.pickupTour[n - 1 - i]] - 1;
+                plan.ranks.push_back(last);
+
+                for(int k = 1; k <= n; ++k) plan.ranks.push_back(identity(n - k + 1));
+
+                plan.distance = pickupResult.first + deliveryResult.first;
+                plan.relocations = relocations(last.data(), n);
+                return plan;
+            }
+
+            // Containers hold at most MAX_SMALL_ITEMS items of at most 3 bits each, bottom first, so
+            // a state is the container and the last stop in one integer
+            LoadingPlan solveSmallInstance(int h) {
+
+                const int n = Data::getInstance().numItems;
+                const int l = Data::getInstance().reloadingDepth;
+                const vector < vector < int > > &pickupDistance = Data::getInstance().pickupDistance;
+                const vector < vector < int > > &deliveryDistance = Data::getInstance().deliveryDistance;
+
+                // steps[k]: states after step k, which are stored with their container and last stop
+                vector < vector < State > > steps(2 * n + 1);
+                vector < vector < pair < vector < int >, int > > > configurations(2 * n + 1);
+                steps[0].push_back(State{0, 0, 0, -1, 0, 0});
+                configurations[0].push_back(make_pair(vector < int > (), 0));
+
+                for(int k = 1; k <= 2 * n; ++k) {
+
+                    unordered_map < long long, int > index;
+                    const bool pickup = k <= n;
+
+                    for(int s = 0; s < (int)steps[k-1].size(); ++s) {
+
+                        const State &state = steps[k-1][s];
+                        const vector < int > &stack = configurations[k-1][s].first;
+                        const int last = configurations[k-1][s].second;
+                        const int size = stack.size();
+
+                        for(int item = 1; item <= (pickup ? n : 1); ++item) {
+
+                            if(pickup && find(stack.begin(), stack.end(), item) != stack.end()) continue;
+
+                            int window[8], ranks[8];
+                            const int g = pickup ? min(size + 1, l + 1) : min(size, l + 1);
+                            const int base = pickup ? size - (g - 1) : size - g;
+                            for(int i = 0; i < g; ++i) {
+                                window[i] = (pickup && i == 0) ? item : stack[size - 1 - (pickup ? i - 1 : i)];
+                                ranks[i] = i;
+                            }
+
+                            do {
+                                vector < int > next(stack.begin(), stack.begin() + base);
+                                next.resize(base + g);
+                                for(int i = 0; i < g; ++i) next[base + g - 1 - ranks[i]] = window[i];
+
+                                int stop = pickup ? item : next.back();
+                                int distance = state.distance + (pickup ? pickupDistance[last][stop] : deliveryDistance[last][stop]);
+                                if(!pickup) next.pop_back();
+                                if(k == n) { distance += pickupDistance[stop][0]; stop = 0; }
+                                if(k == 2 * n) { distance += deliveryDistance[stop][0]; stop = 0; }
+
+                                const int numberOfRelocations = state.relocations + relocations(ranks, g);
+                                const int cost = distance + h * numberOfRelocations;
+
+                                long long code = 0;
+                                for(int i = (int)next.size() - 1; i >= 0; --i) code = code * 8 + next[i];
+                                code = code * 8 + stop;
+
+                                int encoded = 0;
+                                for(int i = g - 1; i >= 0; --i) encoded = encoded * 8 + ranks[i];
+
+                                const State successor = {cost, distance, numberOfRelocations, s, pickup ? item : 0, encoded};
+                                unordered_map < long long, int > ::iterator it = index.find(code);
+                                if(it == index.end()) {
+                                    index[code] = steps[k].size();
+                                    steps[k].push_back(successor);
+                                    configurations[k].push_back(make_pair(next, stop));
+                                }
+                                else if(cost < steps[k][it->second].cost) {
+                                    steps[k][it->second] = successor;
+                                }
+                            } while(next_permutation(ranks, ranks + g));
+                        }
+                    }
+                }
+
+                // the last step leaves a single state: an empty container, back at the depot
+                LoadingPlan plan;
+                plan.distance = steps[2 * n][0].distance;
+                plan.relocations = steps[2 * n][0].relocations;
+                plan.pickupTour.resize(n);
+                plan.ranks.resize(2 * n);
+
+                for(int k = 2 * n, s = 0; k >= 1; s = steps[k][s].parent, --k) {
+                    const int g = k <= n ? min(k, l + 1) : min(2 * n - k + 1, l + 1);
+                    for(int i = 0, encoded = steps[k][s].ranks; i < g; ++i, encoded /= 8) plan.ranks[k-1].push_back(encoded % 8);
+                    if(k <= n) plan.pickupTour[k-1] = steps[k][s].item;
+                }
+
+                return plan;
+            }
+
+    public:
+
+            enum Regime { NONE, LIFO, SPLIT_TOURS, SMALL_INSTANCE };
+
+            enum { MAX_SMALL_ITEMS = 6 };
+
+            ExactSolver(int _numThreads = 1, RelocationCounting _counting = DECODER_COUNT) : numThreads(_numThreads), counting(_counting) {}
+
+            // Degenerate case of Data's instance under relocation cost h, if any; the cheapest one
+            // when several apply
+            static Regime detect(int h) {
+                const int n = Data::getInstance().numItems;
+                const int l = Data::getInstance().reloadingDepth;
+                if(l == 0) return LIFO;
+                if(h == 0 && l >= n - 1) return SPLIT_TOURS;
+                if(n <= MAX_SMALL_ITEMS) return SMALL_INSTANCE;
+                return NONE;
+            }
+
+            static const char* describe(Regime regime) {
+                switch(regime) {
+                    case LIFO: return "LIFO (l = 0), one TSP on the combined distances";
+                    case SPLIT_TOURS: return "free relocations (h = 0, l >= n - 1), two independent TSPs";
+                    case SMALL_INSTANCE: return "small instance, dynamic program over the containers";
+                    default: return "none";
+                }
+            }
+
+            // Optimal plan under relocation cost h, as counted by this solver; its pickup tour is
+            // empty if a TSP could not be solved
+            LoadingPlan solve(Regime regime, int h) {
+                if(regime == LIFO) return solveLIFO();
+                if(regime == SPLIT_TOURS) return solveSplitTours();
+                return solveSmallInstance(h);
+            }
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef HELD_KARP_H
+#define HELD_KARP_H
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+using namespace std;
+
+// Exact TSP by the Held-Karp dynamic program, in O(2^(n-1) (n-1)^2) time and O(2^(n-1) (n-1))
+// memory: about 84 MiB for the 21 nodes of the largest instances and 176 MiB for MAX_NODES. Node 0
+// is the start; dp[mask][v] is the length of the shortest path from 0 through the nodes of mask
+// ending at v. Rows are stored mask-major, so each state reads one contiguous row of its predecessor. All
+// subsets of one size depend only on smaller subsets, so each size is swept in parallel.
+
+class HeldKarpSolver {
+
+    private:
+
+            enum { UNREACHED = INT_MAX / 2 };
+
+            int numThreads;
+
+    public:
+
+            enum { MAX_NODES = 22 };
+
+            HeldKarpSolver(int _numThreads = 1) : numThreads(_numThreads) {}
+
+            // Same output as TSPSolver::solve: the tour cost and the tour from node 0 back to node 0
+            pair < int, vector < int > > solve(int n, const vector < vector < int > > &distance) {
+
+                if(n <= 3) {
+                    vector < int > tour;
+                    for(int i = 0; i < n; ++i) tour.push_back(i);
+                    tour.push_back(0);
+                    int cost = 0;
+                    for(int i = 0; i + 1 < (int)tour.size(); ++i) cost += distance[tour[i]][tour[i+1]];
+                    return make_pair(cost, tour);
+                }
+
+                // node v+1 of the instance is bit v of a mask
+                const int m = n - 1;
+                const unsigned numMasks = 1u << m;
+
+                vector < int > dist(m * m);
+                for(int u = 0; u < m; ++u) {
+                    for(int v = 0; v < m; ++v) dist[u * m + v] = distance[u+1][v+1];
+                }
+
+                // masks sorted by number of nodes, so each size is a contiguous range
+                vector < unsigned > layerBegin(m + 2, 0), masks(numMasks);
+                for(unsigned mask = 0; mask < numMasks; ++mask) layerBegin[__builtin_popcount(mask) + 1] += 1;
+                for(int size = 1; size <= m + 1; ++size) layerBegin[size] += layerBegin[size-1];
+                {
+                    vector < unsigned > next(layerBegin.begin(), layerBegin.end() - 1);
+                    for(unsigned mask = 0; mask < numMasks; ++mask) masks[next[__builtin_popcount(mask)]++] = mask;
+                }
+
+                vector < int > dp((size_t)numMasks * m, UNREACHED);
+                for(int v = 0; v < m; ++v) dp[(size_t)(1u << v) * m + v] = distance[0][v+1];
+
+                for(int size = 2; size <= m; ++size) {
+                    #ifdef _OPENMP
+                        #pragma omp parallel for schedule(static) num_threads(numThreads)
+                    #endif
+                    for(int k = (int)layerBegin[size]; k < (int)layerBegin[size+1]; ++k) {
+                        const unsigned mask = masks[k];
+                        int* row = &dp[(size_t)mask * m];
+                        for(int v = 0; v < m; ++v) {
+                            if(!(mask & (1u << v))) continue;
+                            const int* previous = &dp[(size_t)(mask ^ (1u << v)) * m];
+                            int best = UNREACHED;
+                            for(int u = 0; u < m; ++u) {
+                                best = min(best, previous[u] + dist[u * m + v]);
+                            }
+                            row[v] = best;
+                        }
+                    }
+                }
+
+                // close the tour, then walk the optimal path backwards
+                const unsigned full = numMasks - 1;
+                int bestTourCost = UNREACHED, last = 0;
+                for(int v = 0; v < m; ++v) {
+                    if(dp[(size_t)full * m + v] + distance[v+1][0] < bestTourCost) {
+                        bestTourCost = dp[(size_t)full * m + v] + distance[v+1][0];
+                        last = v;
+                    }
+                }
+
+                vector < int > tour(n + 1, 0);
+                unsigned mask = full;
+                for(int position = n - 1; position >= 1; --position) {
+                    tour[position] = last + 1;
+                    const unsigned rest = mask ^ (1u << last);
+                    for(int u = 0; rest != 0 && u < m; ++u) {
+                        if((rest & (1u << u)) && dp[(size_t)rest * m + u] + dist[u * m + last] == dp[(size_t)mask * m + last]) {
+                            last = u;
+                            break;
+                        }
+                    }
+                    mask = rest;
+                }
+
+                if(tour[1] > tour[n-1]) reverse(tour.begin() + 1, tour.begin() + n);
+
+                return make_pair(bestTourCost, tour);
+            }
+};
+
+#endif
@@ -7,7 +7,7 @@
 
 #include "data.h"
 #include "ilp_formulation_1.h"
-#include "tsp_solver.h"
+#include "tsp_heuristic.h"
 #include "callbacks.h"
 
 using namespace std;
@@ -285,7 +285,7 @@ void ILPFormulation1::setAnInitialSolution() {
         }
     }
 
-    TSPSolver tsp;
+    TSPHeuristic tsp;
     pair < int, vector < int > > result = tsp.solve(Data::getInstance().numItems+1, distance);
     
     vector < pair < int, int > > pickupTourEdges, deliveryTourEdges;
@@ -350,20 +350,35 @@ void ILPFormulation1::setAnInitialSolution() {
     }
 }
 
-void ILPFormulation1::solve(const string outputSolutionFileName) {
+void ILPFormulation1::setAnInitialSolution(const LoadingPlan &plan) {
+
+    vector < GRBVar > variables = getPlanVariables();
+    vector < double > values = valuesFromPlan(plan);
+    for(int i = 0; i < (int)variables.size(); ++i) {
+        variables[i].set(GRB_DoubleAttr_Start, values[i]);
+    }
+
+    // objPart1 and objPart2 come last; as the objective is integral, only solutions at least as
+    // good as the plan are kept
+    model->set(GRB_DoubleParam_Cutoff, plan.distance + Data::getInstance().costForEachRealoading * values.back() + 0.5);
+}
+
+void ILPFormulation1::solve(const string outputSolutionFileName, SolutionExchange *exchange) {
 
     using namespace std::chrono;
     high_resolution_clock::time_point t1 = high_resolution_clock::now();
 
     model->set(GRB_StringParam_LogFile, outputSolutionFileName + ".gurobilog");
         
-    LogCallback cb(objPart1, objPart2);
+    LogCallback *cb;
+    if(exchange == NULL) cb = new LogCallback(objPart1, objPart2);
+    else cb = new ExchangeCallback < ILPFormulation1 > (objPart1, objPart2, *this, *exchange);
     
-    model->setCallback(&cb);
+    model->setCallback(cb);
     
     model->optimize();
     
-    cb.saveSummarizedLog(outputSolutionFileName + ".log");
+    cb->saveSummarizedLog(outputSolutionFileName + ".log");
 
     high_resolution_clock::time_point t2 = high_resolution_clock::now();
     duration < double > time_span = duration_cast < duration < double > > (t2 - t1);
@@ -375,22 +390,30 @@ void ILPFormulation1::solve(const string outputSolutionFileName) {
         exit(0);
     }
 
-    if(model->get(GRB_IntAttr_SolCount) >= 1) {
+    // the cutoff keeps the warm start itself, so it only cuts everything off when the model rejects
+    // the start: the plan and the model disagree, and the optimum lies above the cost of the plan
+    if(status == GRB_CUTOFF) {
+        clog << "The model rejects the warm start, and has no solution as cheap as it" << endl;
+    }
+
+    // without a solution, the bound is all there is to report
+    const bool hasSolution = model->get(GRB_IntAttr_SolCount) >= 1;
+    if(hasSolution) {
         saveSolution(outputSolutionFileName + ".sol");
     }
 
     double currentLowerBound = (double)model->get(GRB_DoubleAttr_ObjBoundC);
     int lowerBound = (int)(model->get(GRB_DoubleAttr_ObjBound)+0.5);
-    int upperBound = (int)(model->get(GRB_DoubleAttr_ObjVal)+0.5);
+    int upperBound = hasSolution ? (int)(model->get(GRB_DoubleAttr_ObjVal)+0.5) : INF;
     int totalDistanceTraveled = getTotalDistanceTraveled();
     int totalNumberOfRelocations = getTotalNumberOfRelocations();
-    double gap = (double)model->get(GRB_DoubleAttr_MIPGap);
+    double gap = hasSolution ? (double)model->get(GRB_DoubleAttr_MIPGap) : INF;
 
     char tmp[10000];
     strcpy(tmp, outputSolutionFileName.c_str());
     strcat(tmp, ".log");    
     ofstream fout(tmp, ofstream::app);  
-    if(cb.lastLB != lowerBound) {
+    if(cb->lastLB != lowerBound) {
         sprintf(tmp, "%15d %15d %17.1lf", upperBound, lowerBound, time_span.count());    
         fout << tmp << endl;
     }
@@ -398,7 +421,10 @@ void ILPFormulation1::solve(const string outputSolutionFileName) {
     sprintf(tmp, "%-20s %15.3lf %15d %15d %15d %15d %15.5lf %15.3lf %15d\n", outputSolutionFileName.c_str(), currentLowerBound, lowerBound, upperBound, totalDistanceTraveled, totalNumberOfRelocations, gap, time_span.count(), status == GRB_OPTIMAL ? 1 : 0);
     fout << tmp << endl;
     
-    // cb.nds.saveSet(outputSolutionFileName + ".nds");
+    // cb->nds.saveSet(outputSolutionFileName + ".nds");
+
+    model->setCallback(NULL);
+    delete cb;
 }
 
 int ILPFormulation1::getTotalCost() const {
@@ -512,3 +538,118 @@ void ILPFormulation1::saveSolution(const string outputSolutionFileName) {
     }
     fout << endl;
 }
+
+vector < GRBVar > ILPFormulation1::getPlanVariables() const {
+
+    const int n = Data::getInstance().numItems;
+    vector < GRBVar > variables;
+
+    for(int k = 1; k <= n; ++k) {
+        for(int l = 1; l <= k; ++l) {
+            for(int j = 1; j <= n; ++j) variables.push_back(y[PICKUP][j][k][l]);
+        }
+    }
+    for(int k = 1; k <= n; ++k) {
+        for(int l = 1; l <= n - k + 1; ++l) {
+            for(int j = 1; j <= n; ++j) variables.push_back(y[DELIVERY][j][k][l]);
+        }
+    }
+    for(int r = PICKUP; r <= DELIVERY; ++r) {
+        for(int k = 1; k <= n + 1; ++k) {
+            for(int i = 0; i <= n; ++i) {
+                for(int j = 0; j <= n; ++j) {
+                    if(j == i) continue;
+                    variables.push_back(x[i][j][k][r]);
+                }
+            }
+        }
+    }
+    for(int k = 1; k <= n - 1; ++k) {
+        variables.push_back(z[k][PICKUP]);
+        variables.push_back(z[k][DELIVERY]);
+    }
+    variables.push_back(objPart1);
+    variables.push_back(objPart2);
+
+    return variables;
+}
+
+LoadingPlan ILPFormulation1::planFromValues(const double *values) const {
+
+    const int n = Data::getInstance().numItems;
+    vector < vector < int > > container(2 * n);
+
+    for(int k = 1; k <= n; ++k) {
+        container[k-1].assign(k, 0);
+        for(int l = 1; l <= k; ++l) {
+            for(int j = 1; j <= n; ++j) {
+                if(*values++ > 0.5) container[k-1][l-1] = j;
+            }
+        }
+    }
+    for(int k = 1; k <= n; ++k) {
+        container[n+k-1].assign(n - k + 1, 0);
+        for(int l = 1; l <= n - k + 1; ++l) {
+            for(int j = 1; j <= n; ++j) {
+                if(*values++ > 0.5) container[n+k-1][l-1] = j;
+            }
+        }
+    }
+
+    return loadingPlanFromTimeline(container, ILP_COUNT);
+}
+
+vector < double > ILPFormulation1::valuesFromPlan(const LoadingPlan &plan) const {
+
+    const int n = Data::getInstance().numItems;
+    vector < int > deliveryTour;
+    vector < vector < int > > container = replayLoadingPlan(plan, deliveryTour);
+    vector < double > values;
+
+    for(int k = 1; k <= n; ++k) {
+        for(int l = 1; l <= k; ++l) {
+            for(int j = 1; j <= n; ++j) values.push_back(container[k-1][l-1] == j ? 1.0 : 0.0);
+        }
+    }
+    for(int k = 1; k <= n; ++k) {
+        for(int l = 1; l <= n - k + 1; ++l) {
+            for(int j = 1; j <= n; ++j) values.push_back(container[n+k-1][l-1] == j ? 1.0 : 0.0);
+        }
+    }
+
+    // stops of both tours, depot at both ends
+    vector < int > tour[2];
+    tour[PICKUP].push_back(0);
+    tour[PICKUP].insert(tour[PICKUP].end(), plan.pickupTour.begin(), plan.pickupTour.end());
+    tour[PICKUP].push_back(0);
+    tour[DELIVERY].push_back(0);
+    tour[DELIVERY].insert(tour[DELIVERY].end(), deliveryTour.begin(), deliveryTour.end());
+    tour[DELIVERY].push_back(0);
+
+    int distance = 0;
+    for(int r = PICKUP; r <= DELIVERY; ++r) {
+        for(int k = 1; k <= n + 1; ++k) {
+            distance += (r == PICKUP ? Data::getInstance().pickupDistance : Data::getInstance().deliveryDistance)[tour[r][k-1]][tour[r][k]];
+            for(int i = 0; i <= n; ++i) {
+                for(int j = 0; j <= n; ++j) {
+                    if(j == i) continue;
+                    values.push_back(i == tour[r][k-1] && j == tour[r][k] ? 1.0 : 0.0);
+                }
+            }
+        }
+    }
+
+    // z_{kP} prices pickup k + 1, z_{kD} delivery k
+    int relocations = 0;
+    for(int k = 1; k <= n - 1; ++k) {
+        const int pickup = countAsILP(plan.ranks[k].data(), plan.ranks[k].size());
+        const int delivery = countAsILP(plan.ranks[n+k-1].data(), plan.ranks[n+k-1].size());
+        values.push_back(pickup);
+        values.push_back(delivery);
+        relocations += pickup + delivery;
+    }
+    values.push_back(distance);
+    values.push_back(relocations);
+
+    return values;
+}
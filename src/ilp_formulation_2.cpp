@@ -7,7 +7,7 @@
 
 #include "data.h"
 #include "ilp_formulation_2.h"
-#include "tsp_solver.h"
+#include "tsp_heuristic.h"
 
 using namespace std;
 
@@ -260,7 +260,7 @@ void ILPFormulation2::setAnInitialSolution() {
         }
     }
 
-    TSPSolver tsp;
+    TSPHeuristic tsp;
     pair < int, vector < int > > result = tsp.solve(Data::getInstance().numItems+1, distance);
 
     vector < vector < bool > > adjMatrix((int)result.second.size()-1, vector < bool > ((int)result.second.size()-1, false));
@@ -320,20 +320,35 @@ void ILPFormulation2::setAnInitialSolution() {
     }
 }
 
-void ILPFormulation2::solve(const string outputSolutionFileName) {
+void ILPFormulation2::setAnInitialSolution(const LoadingPlan &plan) {
+
+    vector < GRBVar > variables = getPlanVariables();
+    vector < double > values = valuesFromPlan(plan);
+    for(int i = 0; i < (int)variables.size(); ++i) {
+        variables[i].set(GRB_DoubleAttr_Start, values[i]);
+    }
+
+    // objPart1 and objPart2 come last; as the objective is integral, only solutions at least as
+    // good as the plan are kept
+    model->set(GRB_DoubleParam_Cutoff, plan.distance + Data::getInstance().costForEachRealoading * values.back() + 0.5);
+}
+
+void ILPFormulation2::solve(const string outputSolutionFileName, SolutionExchange *exchange) {
 
     using namespace std::chrono;
     high_resolution_clock::time_point t1 = high_resolution_clock::now();
 
     model->set(GRB_StringParam_LogFile, outputSolutionFileName + ".gurobilog");
         
-    LogCallback cb(objPart1, objPart2);
+    LogCallback *cb;
+    if(exchange == NULL) cb = new LogCallback(objPart1, objPart2);
+    else cb = new ExchangeCallback < ILPFormulation2 > (objPart1, objPart2, *this, *exchange);
     
-    model->setCallback(&cb);
+    model->setCallback(cb);
     
     model->optimize();
     
-    cb.saveSummarizedLog(outputSolutionFileName + ".log");
+    cb->saveSummarizedLog(outputSolutionFileName + ".log");
 
     high_resolution_clock::time_point t2 = high_resolution_clock::now();
     duration < double > time_span = duration_cast < duration < double > > (t2 - t1);
@@ -345,22 +360,30 @@ void ILPFormulation2::solve(const string outputSolutionFileName) {
         exit(0);
     }
 
-    if(model->get(GRB_IntAttr_SolCount) >= 1) {
+    // the cutoff keeps the warm start itself, so it only cuts everything off when the model rejects
+    // the start: the plan and the model disagree, and the optimum lies above the cost of the plan
+    if(status == GRB_CUTOFF) {
+        clog << "The model rejects the warm start, and has no solution as cheap as it" << endl;
+    }
+
+    // without a solution, the bound is all there is to report
+    const bool hasSolution = model->get(GRB_IntAttr_SolCount) >= 1;
+    if(hasSolution) {
         saveSolution(outputSolutionFileName + ".sol");
     }
 
     double currentLowerBound = (double)model->get(GRB_DoubleAttr_ObjBoundC);
     int lowerBound = (int)(model->get(GRB_DoubleAttr_ObjBound)+0.5);
-    int upperBound = (int)(model->get(GRB_DoubleAttr_ObjVal)+0.5);
+    int upperBound = hasSolution ? (int)(model->get(GRB_DoubleAttr_ObjVal)+0.5) : INF;
     int totalDistanceTraveled = getTotalDistanceTraveled();
     int totalNumberOfRelocations = getTotalNumberOfRelocations();
-    double gap = (double)model->get(GRB_DoubleAttr_MIPGap);
+    double gap = hasSolution ? (double)model->get(GRB_DoubleAttr_MIPGap) : INF;
 
     char tmp[10000];
     strcpy(tmp, outputSolutionFileName.c_str());
     strcat(tmp, ".log");    
     ofstream fout(tmp, ofstream::app);  
-    if(cb.lastLB != lowerBound) {
+    if(cb->lastLB != lowerBound) {
         sprintf(tmp, "%15d %15d %17.1lf", upperBound, lowerBound, time_span.count());    
         fout << tmp << endl;
     }
@@ -368,7 +391,10 @@ void ILPFormulation2::solve(const string outputSolutionFileName) {
     sprintf(tmp, "%-20s %15.3lf %15d %15d %15d %15d %15.5lf %15.3lf %15d\n", outputSolutionFileName.c_str(), currentLowerBound, lowerBound, upperBound, totalDistanceTraveled, totalNumberOfRelocations, gap, time_span.count(), status == GRB_OPTIMAL ? 1 : 0);
     fout << tmp << endl;
     
-    // cb.nds.saveSet(outputSolutionFileName + ".nds");
+    // cb->nds.saveSet(outputSolutionFileName + ".nds");
+
+    model->setCallback(NULL);
+    delete cb;
 }
 
 int ILPFormulation2::getTotalCost() const {
@@ -491,3 +517,115 @@ void ILPFormulation2::saveSolution(const string outputSolutionFileName) {
     }
     fout << endl;
 }
+
+vector < GRBVar > ILPFormulation2::getPlanVariables() const {
+
+    const int n = Data::getInstance().numItems;
+    vector < GRBVar > variables;
+
+    for(int k = 1; k <= n; ++k) {
+        for(int l = 1; l <= k; ++l) {
+            for(int j = 1; j <= n; ++j) variables.push_back(y[PICKUP][j][k][l]);
+        }
+    }
+    for(int k = 1; k <= n; ++k) {
+        for(int l = 1; l <= n - k + 1; ++l) {
+            for(int j = 1; j <= n; ++j) variables.push_back(y[DELIVERY][j][k][l]);
+        }
+    }
+    for(int r = PICKUP; r <= DELIVERY; ++r) {
+        for(int i = 0; i <= n; ++i) {
+            for(int j = 0; j <= n; ++j) variables.push_back(chi[i][j][r]);
+        }
+        for(int j = 0; j <= n; ++j) variables.push_back(u[j][r]);
+    }
+    for(int k = 1; k <= n - 1; ++k) {
+        variables.push_back(z[k][PICKUP]);
+        variables.push_back(z[k][DELIVERY]);
+    }
+    variables.push_back(objPart1);
+    variables.push_back(objPart2);
+
+    return variables;
+}
+
+LoadingPlan ILPFormulation2::planFromValues(const double *values) const {
+
+    const int n = Data::getInstance().numItems;
+    vector < vector < int > > container(2 * n);
+
+    for(int k = 1; k <= n; ++k) {
+        container[k-1].assign(k, 0);
+        for(int l = 1; l <= k; ++l) {
+            for(int j = 1; j <= n; ++j) {
+                if(*values++ > 0.5) container[k-1][l-1] = j;
+            }
+        }
+    }
+    for(int k = 1; k <= n; ++k) {
+        container[n+k-1].assign(n - k + 1, 0);
+        for(int l = 1; l <= n - k + 1; ++l) {
+            for(int j = 1; j <= n; ++j) {
+                if(*values++ > 0.5) container[n+k-1][l-1] = j;
+            }
+        }
+    }
+
+    return loadingPlanFromTimeline(container, ILP_COUNT);
+}
+
+vector < double > ILPFormulation2::valuesFromPlan(const LoadingPlan &plan) const {
+
+    const int n = Data::getInstance().numItems;
+    vector < int > deliveryTour;
+    vector < vector < int > > container = replayLoadingPlan(plan, deliveryTour);
+    vector < double > values;
+
+    for(int k = 1; k <= n; ++k) {
+        for(int l = 1; l <= k; ++l) {
+            for(int j = 1; j <= n; ++j) values.push_back(container[k-1][l-1] == j ? 1.0 : 0.0);
+        }
+    }
+    for(int k = 1; k <= n; ++k) {
+        for(int l = 1; l <= n - k + 1; ++l) {
+            for(int j = 1; j <= n; ++j) values.push_back(container[n+k-1][l-1] == j ? 1.0 : 0.0);
+        }
+    }
+
+    // stops of both tours, depot at both ends
+    vector < int > tour[2];
+    tour[PICKUP].push_back(0);
+    tour[PICKUP].insert(tour[PICKUP].end(), plan.pickupTour.begin(), plan.pickupTour.end());
+    tour[PICKUP].push_back(0);
+    tour[DELIVERY].push_back(0);
+    tour[DELIVERY].insert(tour[DELIVERY].end(), deliveryTour.begin(), deliveryTour.end());
+    tour[DELIVERY].push_back(0);
+
+    // u_{jr} is the position of stop j in its tour
+    int distance = 0;
+    for(int r = PICKUP; r <= DELIVERY; ++r) {
+        vector < vector < double > > arc(n + 1, vector < double > (n + 1, 0.0));
+        vector < double > position(n + 1, 0.0);
+        for(int k = 1; k <= n + 1; ++k) {
+            distance += (r == PICKUP ? Data::getInstance().pickupDistance : Data::getInstance().deliveryDistance)[tour[r][k-1]][tour[r][k]];
+            arc[tour[r][k-1]][tour[r][k]] = 1.0;
+            if(k <= n) position[tour[r][k]] = k;
+        }
+        for(int i = 0; i <= n; ++i) values.insert(values.end(), arc[i].begin(), arc[i].end());
+        values.insert(values.end(), position.begin(), position.end());
+    }
+
+    // z_{kP} prices pickup k + 1, z_{kD} delivery k
+    int relocations = 0;
+    for(int k = 1; k <= n - 1; ++k) {
+        const int pickup = countAsILP(plan.ranks[k].data(), plan.ranks[k].size());
+        const int delivery = countAsILP(plan.ranks[n+k-1].data(), plan.ranks[n+k-1].size());
+        values.push_back(pickup);
+        values.push_back(delivery);
+        relocations += pickup + delivery;
+    }
+    values.push_back(distance);
+    values.push_back(relocations);
+
+    return values;
+}
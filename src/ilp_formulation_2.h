@@ -3,6 +3,7 @@
 
 #include "gurobi_c++.h"
 #include "callbacks.h"
+#include "solution_exchange.h"
 
 class ILPFormulation2 {
     
@@ -30,11 +31,22 @@ class ILPFormulation2 {
             
             void exportModel(string);
             void setAnInitialSolution();
-            void solve(const string);
+            // Warm start from a plan, e.g., found by a BRKGA, instead of a TSP tour: its values are
+            // the MIP start and its cost the cutoff
+            void setAnInitialSolution(const LoadingPlan&);
+            // With an exchange, the MIP shares its incumbents with a BRKGA run alongside it (HYBRID)
+            void solve(const string, SolutionExchange* = NULL);
             int getTotalCost() const;
             int getTotalDistanceTraveled() const;
             int getTotalNumberOfRelocations() const;
             void saveSolution(const string);
+
+            // The variables a loading plan sets, y first, then the plan their values describe
+            // (empty if they describe none), and their values for a plan; relocations are counted
+            // as the z variables do
+            vector < GRBVar > getPlanVariables() const;
+            LoadingPlan planFromValues(const double*) const;
+            vector < double > valuesFromPlan(const LoadingPlan&) const;
 };
 
 #endif
@@ -0,0 +1,213 @@
+#ifndef LOADING_PLAN_H
+#define LOADING_PLAN_H
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "data.h"
+
+using namespace std;
+
+// A loading plan as Decoder::evaluate() reads it: the pickup tour (items only) and, for each of the
+// 2n steps, the rank that every item of the rearranged window takes in it (0 on top). The window of
+// a pickup is the new item and then the stack from the top, that of a delivery the stack from the
+// top. See encodeLoadingPlan() for its chromosome.
+struct LoadingPlan {
+    vector < int > pickupTour;
+    vector < vector < int > > ranks;
+    int distance;
+    int relocations;
+};
+
+// Relocations charged for a rearrangement, from the ranks of its window: the decoder charges the
+// items after the first one that moves, the ILP formulations the items above the lowest position of
+// the container whose item changes, i.e., the index of the last window item that moves
+enum RelocationCounting { DECODER_COUNT, ILP_COUNT };
+
+inline int countAsDecoder(const int* ranks, int g) {
+    for(int i = 0; i < g; ++i) {
+        if(ranks[i] != i) return g - 1 - i;
+    }
+    return 0;
+}
+
+inline int countAsILP(const int* ranks, int g) {
+    for(int i = g - 1; i >= 0; --i) {
+        if(ranks[i] != i) return i;
+    }
+    return 0;
+}
+
+inline int countRelocations(const int* ranks, int g, RelocationCounting counting) {
+    return counting == ILP_COUNT ? countAsILP(ranks, g) : countAsDecoder(ranks, g);
+}
+
+// Container after each pickup and before each delivery, bottom first, as in the timeline of the
+// solution files; the delivery tour is written to deliveryTour
+inline vector < vector < int > > replayLoadingPlan(const LoadingPlan &plan, vector < int > &deliveryTour) {
+
+    const int n = plan.pickupTour.size();
+    vector < vector < int > > timeline;
+    vector < int > stack, window;
+    deliveryTour.clear();
+
+    for(int k = 0; k < 2 * n; ++k) {
+        const int g = plan.ranks[k].size();
+        if(k >= n) timeline.push_back(stack);
+        window.clear();
+        if(k < n) window.push_back(plan.pickupTour[k]);
+        while((int)window.size() < g) {
+            window.push_back(stack.back());
+            stack.pop_back();
+        }
+        const int base = stack.size();
+        stack.resize(base + g);
+        for(int i = 0; i < g; ++i) stack[base + g - 1 - plan.ranks[k][i]] = window[i];
+        if(k < n) timeline.push_back(stack);
+        else {
+            deliveryTour.push_back(stack.back());
+            stack.pop_back();
+        }
+    }
+    return timeline;
+}
+
+// Inverse of replayLoadingPlan(), for Data's instance: the plan that goes through the given
+// containers, with its relocations counted as requested. The pickup tour is empty if the timeline
+// does not describe a feasible plan (an item rearranged below the reloading depth, a container of
+// the wrong size...)
+inline LoadingPlan loadingPlanFromTimeline(const vector < vector < int > > &timeline, RelocationCounting counting) {
+
+    const int n = Data::getInstance().numItems;
+    const int l = Data::getInstance().reloadingDepth;
+
+    LoadingPlan plan;
+    plan.distance = 0;
+    plan.relocations = 0;
+    if((int)timeline.size() != 2 * n) return plan;
+
+    vector < int > pickupTour, deliveryTour, window, ranks;
+    vector < vector < int > > allRanks;
+    const vector < int > empty;
+
+    for(int k = 0; k < 2 * n; ++k) {
+
+        const bool pickup = k < n;
+        const vector < int > &before = pickup ? (k == 0 ? empty : timeline[k-1]) : timeline[k];
+        const vector < int > &next = pickup ? timeline[k] : (k == 2 * n - 1 ? empty : timeline[k+1]);
+        if((int)next.size() != (pickup ? k + 1 : 2 * n - k - 1) || (int)before.size() != (pickup ? k : 2 * n - k)) return LoadingPlan();
+
+        // the container once rearranged: after a pickup, the next one; at a delivery, the next one
+        // with the delivered item on top
+        vector < int > rearranged = next;
+        int item = 0;
+        const vector < int > &larger = pickup ? next : before;
+        const vector < int > &smaller = pickup ? before : next;
+        for(int i = 0; i < (int)larger.size() && item == 0; ++i) {
+            if(find(smaller.begin(), smaller.end(), larger[i]) == smaller.end()) item = larger[i];
+        }
+        if(item == 0) return LoadingPlan();
+        if(!pickup) rearranged.push_back(item);
+
+        const int size = rearranged.size();
+        const int g = min(size, l + 1);
+        window.clear();
+        if(pickup) window.push_back(item);
+        for(int i = before.size() - 1; (int)window.size() < g; --i) window.push_back(before[i]);
+
+        // untouched part of the container
+        for(int i = 0; i < size - g; ++i) {
+            if(rearranged[i] != before[i]) return LoadingPlan();
+        }
+
+        ranks.assign(g, -1);
+        for(int i = 0; i < g; ++i) {
+            for(int r = 0; r < g; ++r) {
+                if(rearranged[size - 1 - r] == window[i]) ranks[i] = r;
+            }
+            if(ranks[i] < 0) return LoadingPlan();
+        }
+
+        allRanks.push_back(ranks);
+        plan.relocations += countRelocations(ranks.data(), g, counting);
+        if(pickup) pickupTour.push_back(item);
+        else deliveryTour.push_back(item);
+    }
+
+    const vector < vector < int > > &pickupDistance = Data::getInstance().pickupDistance;
+    const vector < vector < int > > &deliveryDistance = Data::getInstance().deliveryDistance;
+    for(int i = 0; i <= n; ++i) {
+        plan.distance += pickupDistance[i == 0 ? 0 : pickupTour[i-1]][i == n ? 0 : pickupTour[i]];
+        plan.distance += deliveryDistance[i == 0 ? 0 : deliveryTour[i-1]][i == n ? 0 : deliveryTour[i]];
+    }
+
+    plan.pickupTour = pickupTour;
+    plan.ranks = allRanks;
+    return plan;
+}
+
+// Plan of a solution file of Data's instance, as written by saveLoadingPlan(), Decoder::saveSolution()
+// or the ILP formulations, read from its timeline (see loadingPlanFromTimeline()); the pickup tour is
+// empty if the file cannot be read or is not a solution of this instance
+inline LoadingPlan readLoadingPlan(const string solutionFileIn, RelocationCounting counting) {
+
+    const int n = Data::getInstance().numItems;
+
+    ifstream fin(solutionFileIn.c_str());
+    string line;
+    while(getline(fin, line) && line.find("Loading/unloading plan timeline:") == string::npos);
+    getline(fin, line);
+
+    // one column of 3 characters per container, top row first
+    vector < vector < int > > timeline(2 * n);
+    for(int j = n-1; j >= 0 && getline(fin, line); --j) {
+        for(int i = 0; i < 2 * n && 3 * i < (int)line.size(); ++i) {
+            int item;
+            if(sscanf(line.substr(3 * i, 2).c_str(), "%d", &item) == 1) timeline[i].push_back(item);
+        }
+    }
+    for(int i = 0; i < 2 * n; ++i) reverse(timeline[i].begin(), timeline[i].end());
+
+    return loadingPlanFromTimeline(timeline, counting);
+}
+
+// Same layout as Decoder::saveSolution() and the saveSolution() of the ILP formulations
+inline void saveLoadingPlan(const LoadingPlan &plan, int h, const string solutionFileOut) {
+
+    const int n = plan.pickupTour.size();
+    vector < int > deliveryTour;
+    vector < vector < int > > container = replayLoadingPlan(plan, deliveryTour);
+
+    ofstream fout(solutionFileOut.c_str());
+
+    fout << "Total cost: " << plan.distance + h * plan.relocations << endl;
+    fout << "Distance traveled: " << plan.distance << endl;
+    fout << "Number of relocations: " << plan.relocations << endl << endl;
+
+    fout << "Loading/unloading plan timeline:" << endl << endl;
+
+    for(int j = n-1; j >= 0; --j) {
+        for(int i = 0; i < (int)container.size(); ++i) {
+            if(j >= (int)container[i].size()) fout << "   ";
+            else fout << setfill('0') << setw(2) << container[i][j] << ' ';
+        }
+        fout << endl;
+    }
+
+    fout << endl;
+
+    fout << "Pickup tour  : 00";
+    for(int i = 0; i < n; ++i) fout << " --> " << setfill('0') << setw(2) << plan.pickupTour[i];
+    fout << " --> 00" << endl;
+    fout << "Delivery tour: 00";
+    for(int i = 0; i < n; ++i) fout << " --> " << setfill('0') << setw(2) << deliveryTour[i];
+    fout << " --> 00" << endl;
+
+    fout.close();
+}
+
+#endif
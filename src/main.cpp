@@ -7,44 +7,78 @@
 #include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <sstream>
 
 #include "data.h"
 #include "ilp_formulation_1.h"
 #include "ilp_formulation_2.h"
 #include "brkga.h"
+#include "mobrkga.h"
+#include "stopping_criteria.h"
+#include "tsp_solver.h"
+#include "exact_solver.h"
+#include "solution_exchange.h"
 
 using namespace std;
 
-inline void runBRKGA(const string outputSolutionFileName) {
+// Relocations never decrease the total cost, so an optimal pickup tour plus an optimal delivery
+// tour bounds from below the cost of any solution. Returns -1 if a TSP could not be solved.
+inline int computeLowerBound(const unsigned numThreads) {
+
+    TSPSolver tsp(numThreads);
+    pair < int, vector < int > > pickupResult = tsp.solve(Data::getInstance().numItems+1, Data::getInstance().pickupDistance);
+    pair < int, vector < int > > deliveryResult = tsp.solve(Data::getInstance().numItems+1, Data::getInstance().deliveryDistance);
+
+    if(pickupResult.second.empty() || deliveryResult.second.empty()) return -1;
+    return pickupResult.first + deliveryResult.first;
+}
+
+// Key is the type each random key is stored as (double, float or FixedKey16). With several
+// relocation costs, each execution answers all of them: the fitness cycles through them every
+// epochLength generations, while the decoder keeps the best solution for each one, and every cost h
+// gets its own <outputSolutionFileName>_<h>.log and .sol files. With numIslands > 1, each execution
+// evolves that many populations, which exchange their numMigrants best chromosomes every
+// migrationInterval generations; the stopping criteria are then checked at every exchange.
+// localSearch ("elite" or "all") applies the decoder's local search to that part of every population
+// every localSearchInterval generations, and "none" never does. encoding selects what chromosomes
+// encode (see Decoder::Encoding), and beamWidth bounds the search of the loading plan of TOURS.
+template < class Key >
+inline void runBRKGA(const string outputSolutionFileName, const vector < int > &relocationCosts, const unsigned epochLength, const unsigned numThreads, const unsigned numConcurrentExecutions, const StoppingCriteria &stoppingCriteria, const bool hugePages, const unsigned long cacheSize, const unsigned numIslands, const unsigned migrationInterval, const unsigned numMigrants, const string localSearch, const unsigned localSearchInterval, const Decoder::Encoding encoding, const unsigned beamWidth) {
     
-    int chromosomeSize = Data::getInstance().numItems;       
     double _a = 200;
     double _pe = 0.10;
     double _pm = 0.25;
     double _rhoe = 0.70; 
-        
-    for(int k = 1; k <= Data::getInstance().numItems; ++k) {
-        chromosomeSize += min(k, Data::getInstance().reloadingDepth + 1);
-    }
     
-    for(int k = 1; k <= Data::getInstance().numItems; ++k) {
-        chromosomeSize += min(Data::getInstance().numItems - k + 1, Data::getInstance().reloadingDepth + 1);
-    }
+    const unsigned MAXT = numThreads;        // number of threads for parallel decoding
+    
+    Decoder decoder(1.0, 1.0, MAXT, 0, encoding, beamWidth);    // initialize the decoder
+    
+    int chromosomeSize = decoder.getChromosomeSize();
 
     const unsigned p = chromosomeSize * _a;  // size of population
     const double pe = _pe;                   // fraction of population to be the elite-set
     const double pm = _pm;                   // fraction of population to be replaced by mutants
     const double rhoe = _rhoe;               // probability that offspring inherit an allele from elite parent
-    const unsigned K = 1;                    // number of independent populations
-    const unsigned MAXT = 1;                 // number of threads for parallel decoding
+    const unsigned K = numIslands;           // number of independent populations
+    const unsigned J = (K > 1) ? migrationInterval : 0;    // generations between elite exchanges
+    const unsigned step = (J > 0) ? J : 1;   // generations evolved between checks of the stopping criteria
+    const unsigned improved = (localSearch == "all") ? p : (localSearch == "elite") ? unsigned(pe * p) : 0;    // chromosomes improved by local search
     
     // clog << _a << ' ' << p << ' ' << pe << ' ' << pm << ' ' << rhoe << ' ' << stoppingCriteriaFactor << endl;
-    
-    Decoder decoder;                  // initialize the decoder
 
-    double runtime = 3600.0;
-    
-    std::vector < std::pair < double, std::vector < double > > > solutions;
+    const int H = relocationCosts.size();
+    const bool multipleCosts = H > 1;
+
+    vector < string > outputFileNames(H, outputSolutionFileName);
+    for(int c = 0; multipleCosts && c < H; ++c) {
+        char suffix[32];
+        sprintf(suffix, "_%02d", relocationCosts[c]);
+        outputFileNames[c] += suffix;
+    }
+
+    // solutions[c][exec]: best cost for relocationCosts[c] and its keys, as doubles in [0,1)
+    std::vector < std::vector < std::pair < double, std::vector < double > > > > solutions(H);
 
     long unsigned rng_seed[] = {
                                     269070,  99470, 126489, 644764, 547617, 642580,  73456, 462018, 858990, 756112, 
@@ -59,27 +93,57 @@ inline void runBRKGA(const string outputSolutionFileName) {
                                     571216, 306614, 308010, 661191, 890429, 425031,  69108, 435783,  17725, 335928
                                 };
                                 
-    int _NUM_EXECUTIONS = 10;
+    const int _NUM_EXECUTIONS = 10;
 
-    solutions.resize(_NUM_EXECUTIONS);
-    
-    ofstream fout(outputSolutionFileName + ".log");
-    fout << "        UB            Time(s)" << endl;
+    vector < ofstream > fout(H);
+    for(int c = 0; c < H; ++c) {
+        solutions[c].resize(_NUM_EXECUTIONS);
+        fout[c].open(outputFileNames[c] + ".log");
+        fout[c] << "        UB            Time(s)" << endl;
+    }
     
+    #ifdef _OPENMP
+        // each execution decodes with MAXT threads of its own, split among its islands when they
+        // evolve concurrently (see BRKGA::evolve()): one nesting level for the executions, one for
+        // the islands and one for the threads of each island
+        const bool islandsConcurrent = K > 1 && MAXT >= K;
+        const int threadsPerIsland = islandsConcurrent ? MAXT / K : MAXT;
+        const int levels = (numConcurrentExecutions > 1) + islandsConcurrent + (threadsPerIsland > 1);
+        if(levels > 1) omp_set_max_active_levels(levels);
+    #endif
+
     using namespace std::chrono;
     high_resolution_clock::time_point startTime = high_resolution_clock::now();
     
-    for(unsigned exec = 0; exec < _NUM_EXECUTIONS; ++exec) {
+    // executions are independent: each one has its own RNG, decoder and populations, and its log
+    // lines are buffered so that the log keeps the execution order
+    #ifdef _OPENMP
+        #pragma omp parallel for ordered schedule(dynamic) num_threads(numConcurrentExecutions)
+    #endif
+    for(int exec = 0; exec < _NUM_EXECUTIONS; ++exec) {
         
-        fout << "exec #" << fixed << exec+1 << endl;
+        vector < stringstream > execLog(H);
         
         MTRand rng(rng_seed[exec]);  // initialize the random number generator
+        
+        Decoder execDecoder(1.0, 1.0, MAXT, cacheSize, encoding, beamWidth);
+        execDecoder.setRelocationCost(relocationCosts[0]);
+        if(multipleCosts) execDecoder.trackRelocationCosts(relocationCosts);
     
         // initialize the BRKGA-based heuristic
-        BRKGA < Decoder, MTRand > algorithm(chromosomeSize, p, pe, pm, rhoe, decoder, rng, K, MAXT);
+        BRKGA < Decoder, MTRand, Key > algorithm(chromosomeSize, p, pe, pm, rhoe, execDecoder, rng, K, MAXT, hugePages);
+        execDecoder.mergeArchives();
         
-        fout << fixed << setw(10) << (int)algorithm.getBestFitness() << "        " << fixed << setw(12) << setprecision(1) << 0.0 << endl;
-        int lastUB = (int)algorithm.getBestFitness();
+        vector < double > bestCosts = multipleCosts ? execDecoder.incumbentCost : vector < double > (1, algorithm.getBestFitness());
+        vector < int > lastUB(H);
+        for(int c = 0; c < H; ++c) {
+            execLog[c] << "exec #" << fixed << exec+1 << endl;
+            execLog[c] << fixed << setw(10) << (int)bestCosts[c] << "        " << fixed << setw(12) << setprecision(1) << 0.0 << endl;
+            lastUB[c] = (int)bestCosts[c];
+        }
+        
+        SearchStatus status(bestCosts);
+        int fitnessCost = 0;    // index of the relocation cost currently used as fitness
         
         using namespace std::chrono;
         high_resolution_clock::time_point t1 = high_resolution_clock::now();
@@ -89,47 +153,405 @@ inline void runBRKGA(const string outputSolutionFileName) {
             high_resolution_clock::time_point t2 = high_resolution_clock::now();
             duration<double> time_span = duration_cast<duration<double> >(t2 - t1);
 
-            if((double)time_span.count() >= runtime) break;
+            status.elapsedTime = (double)time_span.count();
+            if(stoppingCriteria.isSatisfied(status)) break;
 
-            algorithm.evolve();  // evolve the population for one generation
+            algorithm.evolve(step, J, numMigrants);  // evolve the populations up to the next exchange
+            if(improved > 0 && (status.generation + step) / localSearchInterval != status.generation / localSearchInterval) {
+                algorithm.improve(improved);
+            }
+            execDecoder.mergeArchives();
+            
+            bestCosts = multipleCosts ? execDecoder.incumbentCost : vector < double > (1, algorithm.getBestFitness());
+            status.update(bestCosts, step);
+            
+            for(int c = 0; c < H; ++c) {
+                if(lastUB[c] != (int)bestCosts[c]) {
+                    execLog[c] << fixed << setw(10) << (int)bestCosts[c] << "        " << fixed << setw(12) << setprecision(1) << (double)time_span.count() << endl;
+                    lastUB[c] = (int)bestCosts[c];
+                }
+            }
             
-            if(lastUB != (int)algorithm.getBestFitness()) {
-                fout << fixed << setw(10) << (int)algorithm.getBestFitness() << "        " << fixed << setw(12) << setprecision(1) << (double)time_span.count() << endl;
-                lastUB = (int)algorithm.getBestFitness();
+            // next epoch: switch the fitness to the next relocation cost and re-rank the elite
+            if(multipleCosts && status.generation / epochLength != (status.generation - step) / epochLength) {
+                fitnessCost = (fitnessCost + 1) % H;
+                execDecoder.setRelocationCost(relocationCosts[fitnessCost]);
+                algorithm.redecodeElite();
+                execDecoder.mergeArchives();
             }
         }
         
-        solutions[exec] = std::make_pair(algorithm.getBestFitness(), algorithm.getBestChromosome());
+        for(int c = 0; cacheSize > 0 && c < H; ++c) {
+            execLog[c] << "cache hits: " << execDecoder.getCacheHits() << " of " << execDecoder.getCacheLookups() << " decodes" << endl;
+        }
+        
+        for(int c = 0; c < H; ++c) {
+            if(multipleCosts) {
+                solutions[c][exec] = std::make_pair(execDecoder.incumbentCost[c], execDecoder.incumbentKeys[c]);
+            }
+            else {
+                Span < const Key > bestChromosome = algorithm.getBestChromosome();
+                vector < double > keys(bestChromosome.size());
+                for(int j = 0; j < (int)keys.size(); ++j) keys[j] = KeyTraits < Key >::toUnit(bestChromosome[j]);
+                solutions[c][exec] = std::make_pair(algorithm.getBestFitness(), keys);
+            }
+        }
+        
+        #ifdef _OPENMP
+            #pragma omp ordered
+        #endif
+        {
+            for(int c = 0; c < H; ++c) fout[c] << execLog[c].str() << flush;
+            decoder.nds.merge(execDecoder.nds);
+        }
     }
     
     high_resolution_clock::time_point endTime = high_resolution_clock::now();
     duration < double > time_span = duration_cast < duration < double > > (endTime - startTime);
     
-    std::pair < double, vector < double > > bestSolution = solutions[0];
-    for(unsigned exec = 1; exec < _NUM_EXECUTIONS; ++exec) {
-        if(solutions[exec].first < bestSolution.first) {
-            bestSolution = solutions[exec];
+    for(int c = 0; c < H; ++c) {
+        
+        std::pair < double, vector < double > > bestSolution = solutions[c][0];
+        for(int exec = 1; exec < _NUM_EXECUTIONS; ++exec) {
+            if(solutions[c][exec].first < bestSolution.first) {
+                bestSolution = solutions[c][exec];
+            }
+        }
+
+        fout[c] << endl;
+        char tmp[10000];
+        sprintf(tmp, "%-20s ", outputFileNames[c].c_str()); fout[c] << tmp;
+        for(int exec = 0; exec < _NUM_EXECUTIONS; ++exec) {
+            sprintf(tmp, "%15.0lf ", solutions[c][exec].first); fout[c] << tmp;
+        }    
+        sprintf(tmp, "%15.3lf", (double)time_span.count()); fout[c] << tmp << endl;
+        
+        fout[c].close();
+
+        // save the best solution found
+        decoder.setRelocationCost(relocationCosts[c]);
+        decoder.saveSolution(bestSolution.second, outputFileNames[c] + ".sol");
+    }
+    
+    // the archive from which every relocation cost was answered
+    if(multipleCosts) decoder.nds.saveSet(outputSolutionFileName + ".nds");
+}
+ 
+// Shortest distance of the front among the solutions with at most r relocations, for each r up to
+// maxRelocations: a front improves exactly when one of these does
+inline vector < double > frontProfile(const NonDominatedSet &front, const int maxRelocations) {
+
+    vector < double > profile(maxRelocations + 1, INF);
+    const vector < pair < int, int > > &points = front.getPoints();
+    for(int i = 0; i < (int)points.size(); ++i) {
+        for(int r = points[i].second; r <= maxRelocations; ++r) profile[r] = min(profile[r], (double)points[i].first);
+    }
+    return profile;
+}
+
+// Approximates the whole distance/relocations Pareto front instead of one weighted cost: each
+// execution runs a MOBRKGA, the decoder archives every solution decoded, and the union of the
+// archives of all executions is saved as <outputSolutionFileName>.nds. The log follows the size of
+// the front of each execution.
+template < class Key >
+inline void runMOBRKGA(const string outputSolutionFileName, const unsigned numThreads, const unsigned numConcurrentExecutions, const StoppingCriteria &stoppingCriteria, const bool hugePages, const unsigned long cacheSize) {
+
+    double _a = 200;
+    double _pe = 0.10;
+    double _pm = 0.25;
+    double _rhoe = 0.70;
+
+    const unsigned MAXT = numThreads;        // number of threads for parallel decoding
+
+    Decoder decoder(1.0, 1.0, MAXT);         // holds the merged archive
+
+    int chromosomeSize = decoder.getChromosomeSize();
+
+    const unsigned p = chromosomeSize * _a;  // size of population
+    const double pe = _pe;                   // fraction of population to be the elite-set
+    const double pm = _pm;                   // fraction of population to be replaced by mutants
+    const double rhoe = _rhoe;               // probability that offspring inherit an allele from elite parent
+
+    // each of the 2n loading steps relocates at most l items
+    const int maxRelocations = 2 * Data::getInstance().numItems * Data::getInstance().reloadingDepth;
+
+    long unsigned rng_seed[] = {
+                                    269070,  99470, 126489, 644764, 547617, 642580,  73456, 462018, 858990, 756112
+                                };
+
+    const int _NUM_EXECUTIONS = 10;
+
+    vector < int > frontSizes(_NUM_EXECUTIONS);
+
+    ofstream fout(outputSolutionFileName + ".log");
+    fout << "     Front            Time(s)" << endl;
+
+    #ifdef _OPENMP
+        if(numConcurrentExecutions > 1 && MAXT > 1) omp_set_max_active_levels(2);
+    #endif
+
+    using namespace std::chrono;
+    high_resolution_clock::time_point startTime = high_resolution_clock::now();
+
+    #ifdef _OPENMP
+        #pragma omp parallel for ordered schedule(dynamic) num_threads(numConcurrentExecutions)
+    #endif
+    for(int exec = 0; exec < _NUM_EXECUTIONS; ++exec) {
+
+        stringstream execLog;
+
+        MTRand rng(rng_seed[exec]);  // initialize the random number generator
+
+        Decoder execDecoder(1.0, 1.0, MAXT, cacheSize);
+
+        MOBRKGA < Decoder, MTRand, Key > algorithm(chromosomeSize, p, pe, pm, rhoe, execDecoder, rng, MAXT, hugePages);
+        execDecoder.mergeArchives();
+
+        execLog << "exec #" << fixed << exec+1 << endl;
+        execLog << fixed << setw(10) << execDecoder.nds.size() << "        " << fixed << setw(12) << setprecision(1) << 0.0 << endl;
+
+        SearchStatus status(frontProfile(execDecoder.nds, maxRelocations));
+
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+        while(1) {
+
+            high_resolution_clock::time_point t2 = high_resolution_clock::now();
+            duration<double> time_span = duration_cast<duration<double> >(t2 - t1);
+
+            status.elapsedTime = (double)time_span.count();
+            if(stoppingCriteria.isSatisfied(status)) break;
+
+            algorithm.evolve();  // evolve the population for one generation
+            execDecoder.mergeArchives();
+
+            status.update(frontProfile(execDecoder.nds, maxRelocations));
+
+            if(status.generationsWithoutImprovement == 0) {
+                execLog << fixed << setw(10) << execDecoder.nds.size() << "        " << fixed << setw(12) << setprecision(1) << (double)time_span.count() << endl;
+            }
+        }
+
+        if(cacheSize > 0) execLog << "cache hits: " << execDecoder.getCacheHits() << " of " << execDecoder.getCacheLookups() << " decodes" << endl;
+
+        frontSizes[exec] = execDecoder.nds.size();
+
+        #ifdef _OPENMP
+            #pragma omp ordered
+        #endif
+        {
+            fout << execLog.str() << flush;
+            decoder.nds.merge(execDecoder.nds);
         }
     }
 
+    high_resolution_clock::time_point endTime = high_resolution_clock::now();
+    duration < double > time_span = duration_cast < duration < double > > (endTime - startTime);
+
     fout << endl;
     char tmp[10000];
     sprintf(tmp, "%-20s ", outputSolutionFileName.c_str()); fout << tmp;
-    for(unsigned exec = 0; exec < _NUM_EXECUTIONS; ++exec) {
-        sprintf(tmp, "%15.0lf ", solutions[exec].first); fout << tmp;
-    }    
-    sprintf(tmp, "%15.3lf", (double)time_span.count()); fout << tmp << endl;
-    
+    for(int exec = 0; exec < _NUM_EXECUTIONS; ++exec) {
+        sprintf(tmp, "%15d ", frontSizes[exec]); fout << tmp;
+    }
+    sprintf(tmp, "%15d %15.3lf", decoder.nds.size(), (double)time_span.count()); fout << tmp << endl;
+
     fout.close();
 
-    // save the best solution found
-    decoder.decode(bestSolution.second, outputSolutionFileName + ".sol");
-    
-    // decoder.nds.saveSet(outputSolutionFileName + ".nds");
+    decoder.nds.saveSet(outputSolutionFileName + ".nds");
 }
- 
-inline void usage() { 
-    clog << "\n       Usage ./dtsppl --approach <approach_name> --pickuparea <pickup_area_file_name> --deliveryarea <delivery_area_file_name> --n <number_of_items> --l <reloading_depth> --h <relocation_cost> --outputsolution <solution_file_name> " << endl;
+
+// Answers each relocation cost through the exact procedure of its regime instead of approachID (ILP1,
+// ILP2, HYBRID or BRKGA), and writes the files that approachID would: the .sol of the optimal plan,
+// and a log of the same layout, followed by a line that names the procedure. A BRKGA log reports the
+// optimum for each of its executions. Relocations are counted as approachID counts them (see
+// RelocationCounting). Returns false, having written nothing, if a procedure could not solve a TSP.
+inline bool runExact(const string approachID, const string outputSolutionFileName, const vector < int > &relocationCosts, const vector < ExactSolver::Regime > &regimes, const unsigned numThreads) {
+
+    const int H = relocationCosts.size();
+    const bool multipleCosts = H > 1;
+
+    using namespace std::chrono;
+    high_resolution_clock::time_point startTime = high_resolution_clock::now();
+
+    ExactSolver solver(numThreads, approachID == "BRKGA" ? DECODER_COUNT : ILP_COUNT);
+    vector < LoadingPlan > plans(H);
+    for(int c = 0; c < H; ++c) {
+        // LIFO and SPLIT_TOURS plans do not depend on the relocation cost
+        if(c > 0 && regimes[c] == regimes[0] && regimes[c] != ExactSolver::SMALL_INSTANCE) plans[c] = plans[0];
+        else plans[c] = solver.solve(regimes[c], relocationCosts[c]);
+        if(plans[c].pickupTour.empty()) return false;
+    }
+
+    high_resolution_clock::time_point endTime = high_resolution_clock::now();
+    duration < double > time_span = duration_cast < duration < double > > (endTime - startTime);
+
+    NonDominatedSet nds;
+
+    for(int c = 0; c < H; ++c) {
+
+        string outputFileName = outputSolutionFileName;
+        if(multipleCosts) {
+            char suffix[32];
+            sprintf(suffix, "_%02d", relocationCosts[c]);
+            outputFileName += suffix;
+        }
+
+        const int cost = plans[c].distance + relocationCosts[c] * plans[c].relocations;
+
+        ofstream fout(outputFileName + ".log");
+        char tmp[10000];
+        if(approachID == "BRKGA") {
+            fout << "        UB            Time(s)" << endl;
+            for(int exec = 0; exec < 10; ++exec) {
+                fout << "exec #" << exec+1 << endl;
+                fout << fixed << setw(10) << cost << "        " << fixed << setw(12) << setprecision(1) << (double)time_span.count() << endl;
+            }
+            fout << endl;
+            sprintf(tmp, "%-20s ", outputFileName.c_str()); fout << tmp;
+            for(int exec = 0; exec < 10; ++exec) {
+                sprintf(tmp, "%15d ", cost); fout << tmp;
+            }
+            sprintf(tmp, "%15.3lf", (double)time_span.count()); fout << tmp << endl;
+        }
+        else {
+            fout << "             UB              LB           Time(s)" << endl;
+            sprintf(tmp, "%15d %15d %17.1lf", cost, cost, (double)time_span.count()); fout << tmp << endl;
+            fout << endl;
+            sprintf(tmp, "%-20s %15.3lf %15d %15d %15d %15d %15.5lf %15.3lf %15d\n", outputFileName.c_str(), (double)cost, cost, cost, plans[c].distance, plans[c].relocations, 0.0, (double)time_span.count(), 1);
+            fout << tmp << endl;
+        }
+        fout << "exact: " << ExactSolver::describe(regimes[c]) << endl;
+        fout.close();
+
+        saveLoadingPlan(plans[c], relocationCosts[c], outputFileName + ".sol");
+        nds.add(make_pair(plans[c].distance, plans[c].relocations));
+    }
+
+    if(multipleCosts) nds.saveSet(outputSolutionFileName + ".nds");
+
+    return true;
+}
+
+// Warm start of the ILP formulations: one BRKGA execution, with the parameters of the first one of
+// runBRKGA(), until the stopping criteria; returns the plan of the elite chromosome that the
+// formulations count cheapest, which need not be the best one for the decoder
+inline LoadingPlan runWarmStartBRKGA(const unsigned numThreads, const StoppingCriteria &stoppingCriteria, const bool hugePages, const unsigned long cacheSize) {
+
+    Decoder decoder(1.0, 1.0, numThreads, cacheSize);
+    const unsigned chromosomeSize = decoder.getChromosomeSize();
+
+    MTRand rng(269070);
+    BRKGA < Decoder, MTRand, double > algorithm(chromosomeSize, chromosomeSize * 200, 0.10, 0.25, 0.70, decoder, rng, 1, numThreads, hugePages);
+    decoder.mergeArchives();
+
+    SearchStatus status(algorithm.getBestFitness());
+
+    using namespace std::chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+    while(1) {
+        high_resolution_clock::time_point t2 = high_resolution_clock::now();
+        status.elapsedTime = duration_cast < duration < double > > (t2 - t1).count();
+        if(stoppingCriteria.isSatisfied(status)) break;
+
+        algorithm.evolve();
+        decoder.mergeArchives();
+        status.update(algorithm.getBestFitness());
+    }
+
+    const int h = Data::getInstance().costForEachRealoading;
+    LoadingPlan best;
+    for(unsigned i = 0; i < algorithm.getPe(); ++i) {
+        LoadingPlan plan = loadingPlanFromTimeline(decoder.decodeTimeline(algorithm.getPopulation().getChromosome(i)), ILP_COUNT);
+        if(best.pickupTour.empty() || plan.distance + h * plan.relocations < best.distance + h * best.relocations) best = plan;
+    }
+    return best;
+}
+
+// HYBRID: the MIP of Formulation and a BRKGA run side by side, on a thread each (the BRKGA decodes
+// with the other numThreads - 1), sharing their incumbents and the MIP's bound through a
+// SolutionExchange. The BRKGA stops with the MIP, or before by its own stopping criteria; the output
+// files are those of the formulation, with the exchange counts appended to the log. The MIP starts
+// from warmStart, if not empty.
+template < class Formulation >
+inline void runHybrid(const string outputSolutionFileName, const unsigned numThreads, const StoppingCriteria &stoppingCriteria, const bool hugePages, const unsigned long cacheSize, const LoadingPlan &warmStart) {
+
+    const unsigned MAXT = numThreads > 1 ? numThreads - 1 : 1;    // number of threads for parallel decoding
+
+    Decoder decoder(1.0, 1.0, MAXT, cacheSize);
+    const unsigned chromosomeSize = decoder.getChromosomeSize();
+
+    Formulation formulation;
+    if(warmStart.pickupTour.empty()) formulation.setAnInitialSolution();
+    else formulation.setAnInitialSolution(warmStart);
+
+    SolutionExchange exchange;
+
+    #ifdef _OPENMP
+        if(MAXT > 1) omp_set_max_active_levels(2);
+    #endif
+
+    #ifdef _OPENMP
+        #pragma omp parallel sections num_threads(2)
+    #endif
+    {
+        #ifdef _OPENMP
+            #pragma omp section
+        #endif
+        {
+            formulation.solve(outputSolutionFileName, &exchange);
+            exchange.finish();
+        }
+
+        #ifdef _OPENMP
+            #pragma omp section
+        #endif
+        {
+            // same parameters as the first execution of runBRKGA()
+            MTRand rng(269070);
+            BRKGA < Decoder, MTRand, double > algorithm(chromosomeSize, chromosomeSize * 200, 0.10, 0.25, 0.70, decoder, rng, 1, MAXT, hugePages);
+            decoder.mergeArchives();
+
+            vector < double > keys(chromosomeSize);
+            double lastPosted = INF;
+            SearchStatus status(algorithm.getBestFitness());
+
+            using namespace std::chrono;
+            high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+            while(1) {
+
+                // the decoder counts relocations its own way, so its best solution is posted
+                // whenever it improves, and the exchange compares it on the ILP's count
+                if(algorithm.getBestFitness() < lastPosted) {
+                    lastPosted = algorithm.getBestFitness();
+                    exchange.postFromBRKGA(loadingPlanFromTimeline(decoder.decodeTimeline(algorithm.getBestChromosome()), ILP_COUNT));
+                }
+
+                LoadingPlan plan;
+                if(exchange.takeForBRKGA(plan)) {
+                    encodeLoadingPlan(plan.pickupTour, plan.ranks, Span < double > (keys));
+                    algorithm.inject(keys);
+                }
+
+                high_resolution_clock::time_point t2 = high_resolution_clock::now();
+                status.elapsedTime = duration_cast < duration < double > > (t2 - t1).count();
+                if(exchange.isFinished() || stoppingCriteria.isSatisfied(status)) break;
+
+                algorithm.evolve();
+                decoder.mergeArchives();
+                status.update(algorithm.getBestFitness());
+            }
+        }
+    }
+
+    ofstream fout((outputSolutionFileName + ".log").c_str(), ofstream::app);
+    exchange.saveStatistics(fout);
+}
+
+inline void usage() {
+    clog << "\n       Usage ./dtsppl --approach <approach_name> --pickuparea <pickup_area_file_name> --deliveryarea <delivery_area_file_name> --n <number_of_items> --l <reloading_depth> --h <relocation_cost_or_comma_separated_list> --outputsolution <solution_file_name> [--hepoch <generations_per_relocation_cost>] [--threads <number_of_threads>] [--concurrentexecs <number_of_concurrent_executions>] [--timelimit <seconds>] [--maxstagnation <generations_without_improvement>] [--targetcost <cost>] [--hugepages <0_or_1>] [--keytype <double_float_or_fixed16>] [--cachesize <number_of_cached_solutions>] [--islands <number_of_populations>] [--migrationinterval <generations_between_exchanges>] [--migrants <chromosomes_per_exchange>] [--localsearch <none_elite_or_all>] [--localsearchinterval <generations_between_local_searches>] [--decoder <plan_or_tours>] [--beamwidth <states_per_step>] [--exactcases <0_or_1>] [--ilp <ILP1_or_ILP2>] [--warmstart <none_brkga_or_solution_file>] [--warmstarttime <seconds>] " << endl;
     exit(0);
 }
     
@@ -138,6 +560,23 @@ int main(int argc, char **argv) {
     if(argc < 15) usage();
     
     int numItems, reloadingDepth, costForEachRelocate;
+    vector < int > relocationCosts;
+    int epochLength = 10;
+    int numThreads = 1, numConcurrentExecutions = 1;
+    int maxGenerationsWithoutImprovement = 0;
+    double timeLimit = 3600.0, targetCost = -1.0;
+    int hugePages = 0;
+    string keyType = "double";
+    unsigned long cacheSize = 0;
+    int numIslands = 1, migrationInterval = 20, numMigrants = 2;
+    string localSearch = "none";
+    int localSearchInterval = 1;
+    string decoderName = "plan";
+    int beamWidth = 4;
+    int exactCases = 1;
+    string hybridILP = "ILP1";
+    string warmStartSource = "none";
+    double warmStartTime = 60.0;
     char parameterStr[1000];
     string approachID, pickupAreaFileName, deliveryAreaFileName, outputSolutionFileName;    
     
@@ -148,29 +587,127 @@ int main(int argc, char **argv) {
         else if(strcmp(argv[i], "--deliveryarea") == 0) { sscanf(argv[i+1],"%s", parameterStr); deliveryAreaFileName = parameterStr; check_parameters += 1; }
         else if(strcmp(argv[i], "--n") == 0) { sscanf(argv[i+1],"%d", &numItems); check_parameters += 1; }
         else if(strcmp(argv[i], "--l") == 0) { sscanf(argv[i+1],"%d", &reloadingDepth); check_parameters += 1; }
-        else if(strcmp(argv[i], "--h") == 0) { sscanf(argv[i+1],"%d", &costForEachRelocate); check_parameters += 1; }
+        else if(strcmp(argv[i], "--h") == 0) {
+            stringstream list(argv[i+1]);
+            string h;
+            while(getline(list, h, ',')) { sscanf(h.c_str(), "%d", &costForEachRelocate); relocationCosts.push_back(costForEachRelocate); }
+            if(relocationCosts.empty()) check_parameters = -INF;
+            costForEachRelocate = relocationCosts.empty() ? 0 : relocationCosts[0];
+            check_parameters += 1;
+        }
+        else if(strcmp(argv[i], "--hepoch") == 0) { sscanf(argv[i+1],"%d", &epochLength); if(epochLength < 1) check_parameters = -INF; }
         else if(strcmp(argv[i], "--outputsolution") == 0) { sscanf(argv[i+1],"%s", parameterStr); outputSolutionFileName = parameterStr; check_parameters += 1; }
+        else if(strcmp(argv[i], "--threads") == 0) { sscanf(argv[i+1],"%d", &numThreads); if(numThreads < 1) check_parameters = -INF; }
+        else if(strcmp(argv[i], "--concurrentexecs") == 0) { sscanf(argv[i+1],"%d", &numConcurrentExecutions); if(numConcurrentExecutions < 1) check_parameters = -INF; }
+        else if(strcmp(argv[i], "--timelimit") == 0) { sscanf(argv[i+1],"%lf", &timeLimit); }
+        else if(strcmp(argv[i], "--maxstagnation") == 0) { sscanf(argv[i+1],"%d", &maxGenerationsWithoutImprovement); }
+        else if(strcmp(argv[i], "--targetcost") == 0) { sscanf(argv[i+1],"%lf", &targetCost); }
+        else if(strcmp(argv[i], "--hugepages") == 0) { sscanf(argv[i+1],"%d", &hugePages); }
+        else if(strcmp(argv[i], "--keytype") == 0) { sscanf(argv[i+1],"%s", parameterStr); keyType = parameterStr; }
+        else if(strcmp(argv[i], "--cachesize") == 0) { sscanf(argv[i+1],"%lu", &cacheSize); }
+        else if(strcmp(argv[i], "--islands") == 0) { sscanf(argv[i+1],"%d", &numIslands); if(numIslands < 1) check_parameters = -INF; }
+        else if(strcmp(argv[i], "--migrationinterval") == 0) { sscanf(argv[i+1],"%d", &migrationInterval); if(migrationInterval < 0) check_parameters = -INF; }
+        else if(strcmp(argv[i], "--migrants") == 0) { sscanf(argv[i+1],"%d", &numMigrants); if(numMigrants < 1) check_parameters = -INF; }
+        else if(strcmp(argv[i], "--localsearch") == 0) { sscanf(argv[i+1],"%s", parameterStr); localSearch = parameterStr; if(localSearch != "none" && localSearch != "elite" && localSearch != "all") check_parameters = -INF; }
+        else if(strcmp(argv[i], "--localsearchinterval") == 0) { sscanf(argv[i+1],"%d", &localSearchInterval); if(localSearchInterval < 1) check_parameters = -INF; }
+        else if(strcmp(argv[i], "--decoder") == 0) { sscanf(argv[i+1],"%s", parameterStr); decoderName = parameterStr; if(decoderName != "plan" && decoderName != "tours") check_parameters = -INF; }
+        else if(strcmp(argv[i], "--beamwidth") == 0) { sscanf(argv[i+1],"%d", &beamWidth); if(beamWidth < 0) check_parameters = -INF; }
+        else if(strcmp(argv[i], "--exactcases") == 0) { sscanf(argv[i+1],"%d", &exactCases); }
+        else if(strcmp(argv[i], "--warmstart") == 0) { sscanf(argv[i+1],"%s", parameterStr); warmStartSource = parameterStr; }
+        else if(strcmp(argv[i], "--warmstarttime") == 0) { sscanf(argv[i+1],"%lf", &warmStartTime); }
+        else if(strcmp(argv[i], "--ilp") == 0) { sscanf(argv[i+1],"%s", parameterStr); hybridILP = parameterStr; if(hybridILP != "ILP1" && hybridILP != "ILP2") check_parameters = -INF; }
         else check_parameters = -INF;        
     }
     
     if(check_parameters != 7) usage();
+    if(relocationCosts.size() > 1 && approachID != "BRKGA") usage();
+    if(decoderName != "plan" && approachID != "BRKGA") usage();
+    const Decoder::Encoding encoding = (decoderName == "tours") ? Decoder::TOURS : Decoder::LOADING_PLAN;
     
     Data::getInstance().readData(pickupAreaFileName, deliveryAreaFileName, numItems, reloadingDepth, costForEachRelocate);
       
+    // degenerate parameters are solved exactly when every relocation cost has an exact procedure,
+    // unless disabled; not for the tours decoder, nor for MOBRKGA, whose front is not a single plan
+    vector < ExactSolver::Regime > regimes;
+    bool exact = exactCases != 0 && encoding == Decoder::LOADING_PLAN && (approachID == "ILP1" || approachID == "ILP2" || approachID == "BRKGA" || approachID == "HYBRID");
+    for(int c = 0; exact && c < (int)relocationCosts.size(); ++c) {
+        regimes.push_back(ExactSolver::detect(relocationCosts[c]));
+        if(regimes.back() == ExactSolver::NONE) exact = false;
+    }
+    if(exact && runExact(approachID, outputSolutionFileName, relocationCosts, regimes, numThreads)) return 0;
+
+    // the formulations may start from the plan of a short BRKGA run or of a solution file instead
+    // of a TSP tour
+    LoadingPlan warmStart;
+    if(warmStartSource != "none" && (approachID == "ILP1" || approachID == "ILP2" || approachID == "HYBRID")) {
+        if(warmStartSource == "brkga") {
+            StoppingCriteria stoppingCriteria;
+            stoppingCriteria.add(new TimeLimitCriterion(warmStartTime));
+            if(maxGenerationsWithoutImprovement > 0) stoppingCriteria.add(new StagnationCriterion(maxGenerationsWithoutImprovement));
+            int lowerBound = computeLowerBound(numThreads);
+            if(lowerBound >= 0) stoppingCriteria.add(new TargetCostCriterion(lowerBound));
+            warmStart = runWarmStartBRKGA(numThreads, stoppingCriteria, hugePages != 0, cacheSize);
+        }
+        else {
+            warmStart = readLoadingPlan(warmStartSource, ILP_COUNT);
+            if(warmStart.pickupTour.empty()) clog << "Warm start ignored: " << warmStartSource << " is not a solution of this instance" << endl;
+        }
+    }
+
     if(approachID == "ILP1") {
         ILPFormulation1 ILP1;
-        ILP1.setAnInitialSolution();
+        if(warmStart.pickupTour.empty()) ILP1.setAnInitialSolution();
+        else ILP1.setAnInitialSolution(warmStart);
         ILP1.solve(outputSolutionFileName);
     }
     else if(approachID == "ILP2") {
         ILPFormulation2 ILP2;
-        ILP2.setAnInitialSolution();
+        if(warmStart.pickupTour.empty()) ILP2.setAnInitialSolution();
+        else ILP2.setAnInitialSolution(warmStart);
         ILP2.solve(outputSolutionFileName);
     }   
     else if(approachID == "BRKGA") {
-        runBRKGA(outputSolutionFileName);
+        StoppingCriteria stoppingCriteria;
+        stoppingCriteria.add(new TimeLimitCriterion(timeLimit));
+        if(maxGenerationsWithoutImprovement > 0) stoppingCriteria.add(new StagnationCriterion(maxGenerationsWithoutImprovement));
+        if(targetCost >= 0.0) stoppingCriteria.add(new TargetCostCriterion(targetCost));
+        int lowerBound = computeLowerBound(numThreads);
+        if(lowerBound >= 0) stoppingCriteria.add(new TargetCostCriterion(lowerBound));
+        if(keyType == "double") runBRKGA < double > (outputSolutionFileName, relocationCosts, epochLength, numThreads, numConcurrentExecutions, stoppingCriteria, hugePages != 0, cacheSize, numIslands, migrationInterval, numMigrants, localSearch, localSearchInterval, encoding, beamWidth);
+        else if(keyType == "float") runBRKGA < float > (outputSolutionFileName, relocationCosts, epochLength, numThreads, numConcurrentExecutions, stoppingCriteria, hugePages != 0, cacheSize, numIslands, migrationInterval, numMigrants, localSearch, localSearchInterval, encoding, beamWidth);
+        else if(keyType == "fixed16") runBRKGA < FixedKey16 > (outputSolutionFileName, relocationCosts, epochLength, numThreads, numConcurrentExecutions, stoppingCriteria, hugePages != 0, cacheSize, numIslands, migrationInterval, numMigrants, localSearch, localSearchInterval, encoding, beamWidth);
+        else usage();
+    }
+    else if(approachID == "HYBRID") {
+        StoppingCriteria stoppingCriteria;
+        stoppingCriteria.add(new TimeLimitCriterion(timeLimit));
+        if(maxGenerationsWithoutImprovement > 0) stoppingCriteria.add(new StagnationCriterion(maxGenerationsWithoutImprovement));
+        if(targetCost >= 0.0) stoppingCriteria.add(new TargetCostCriterion(targetCost));
+        int lowerBound = computeLowerBound(numThreads);
+        if(lowerBound >= 0) stoppingCriteria.add(new TargetCostCriterion(lowerBound));
+        if(hybridILP == "ILP1") runHybrid < ILPFormulation1 > (outputSolutionFileName, numThreads, stoppingCriteria, hugePages != 0, cacheSize, warmStart);
+        else runHybrid < ILPFormulation2 > (outputSolutionFileName, numThreads, stoppingCriteria, hugePages != 0, cacheSize, warmStart);
+    }
+    else if(approachID == "MOBRKGA") {
+        // a front improves when any of its points does; targets apply to the shortest distance
+        // without relocations, which is the worst point of the profile
+        StoppingCriteria stoppingCriteria;
+        stoppingCriteria.add(new TimeLimitCriterion(timeLimit));
+        if(maxGenerationsWithoutImprovement > 0) stoppingCriteria.add(new StagnationCriterion(maxGenerationsWithoutImprovement));
+        if(targetCost >= 0.0) stoppingCriteria.add(new TargetCostCriterion(targetCost));
+        int lowerBound = computeLowerBound(numThreads);
+        if(lowerBound >= 0) stoppingCriteria.add(new TargetCostCriterion(lowerBound));
+        if(keyType == "double") runMOBRKGA < double > (outputSolutionFileName, numThreads, numConcurrentExecutions, stoppingCriteria, hugePages != 0, cacheSize);
+        else if(keyType == "float") runMOBRKGA < float > (outputSolutionFileName, numThreads, numConcurrentExecutions, stoppingCriteria, hugePages != 0, cacheSize);
+        else if(keyType == "fixed16") runMOBRKGA < FixedKey16 > (outputSolutionFileName, numThreads, numConcurrentExecutions, stoppingCriteria, hugePages != 0, cacheSize);
+        else usage();
     }
     else usage();
+
+    if(!warmStart.pickupTour.empty()) {
+        ofstream fout((outputSolutionFileName + ".log").c_str(), ofstream::app);
+        fout << "warm start: " << warmStartSource << ", cost " << warmStart.distance + costForEachRelocate * warmStart.relocations << endl;
+    }
     
     return 0;
 }
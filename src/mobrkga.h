@@ -0,0 +1,281 @@
+#ifndef MOBRKGA_H
+#define MOBRKGA_H
+
+#include <algorithm>
+#include <vector>
+
+#include "brkga.h"
+
+/*
+ * MOBRKGA.h
+ *
+ * Multi-objective BRKGA for the two objectives of the decoder, distance traveled and number of
+ * relocations, both minimized. Chromosomes, crossover, mutants, random streams and the generation
+ * loop are those of BRKGA, which MOBRKGA runs with a ranking policy of its own: as in NSGA-II, a
+ * population is ranked by non-dominated front and, within a front, by decreasing crowding distance,
+ * so the elite is the pe best chromosomes in that order. The elite keeps its objectives from one
+ * generation to the next, so each generation only decodes the p - pe new chromosomes.
+ *
+ * With two objectives, non-dominated sorting takes O(p log p) instead of O(p^2): chromosomes are
+ * swept by increasing (distance, relocations), and each one joins the first front whose last member
+ * has more relocations than it. The last members of successive fronts have non-decreasing numbers
+ * of relocations, so that front is found by binary search.
+ *
+ * Decoder must implement std::pair< int, int > decodeObjectives(Span< Key > chromosome, unsigned
+ * threadId), thread-safe for distinct threadIds, returning the distance and the relocations.
+ */
+
+/*
+ * Ranking policy of MOBRKGA (see FitnessRanking). The fitness of a chromosome encodes both of its
+ * objectives as the integer distance * stride + relocations, where stride exceeds any number of
+ * relocations: fitness then orders as (distance, relocations) does, and the elite keeps it from one
+ * generation to the next. The sweep over the fronts starts from a sort of the whole population,
+ * which is a radix sort on such fitness (see Population::sortFitness()). Only the fronts that reach
+ * the elite are ordered by crowding distance; the other chromosomes are left by increasing
+ * objectives.
+ */
+class ParetoRanking {
+public:
+    explicit ParetoRanking(unsigned _stride = 1) : stride(_stride), frontSize(0) {}
+
+    double encode(std::pair< int, int > objectives) const {
+        return double(objectives.first) * stride + objectives.second;
+    }
+
+    std::pair< int, int > decode(double fitness) const {
+        const uint64_t f = uint64_t(fitness);
+        return std::make_pair(int(f / stride), int(f % stride));
+    }
+
+    // Number of chromosomes in the first front, as of the last rank()
+    unsigned getFrontSize() const { return frontSize; }
+
+    template< class Key >
+    void rank(Population< Key >& pop, unsigned pe);
+
+private:
+    uint64_t stride;
+    unsigned frontSize;
+
+    // Scratch space of rank():
+    std::vector< unsigned > frontOf;                            // front of each rank
+    std::vector< int > lastRelocations;                         // relocations of the last member of each front
+    std::vector< std::vector< unsigned > > fronts;              // ranks of each front, by increasing distance
+    std::vector< std::pair< double, unsigned > > crowded;       // (front + crowding term, slot) up to the elite
+    std::vector< double > fitnessOf;                            // fitness of each slot
+    std::vector< bool > isElite;                                // whether each slot is in the elite
+    std::vector< std::pair< double, unsigned > > ranking;       // next ranking of the population
+};
+
+// Ranks a chromosome at its front plus a term in [0, 0.5] that decreases with its crowding distance,
+// which is infinite (term 0) at both ends of a front, and moves the pe best to the front of 'fitness'
+template< class Key >
+inline void ParetoRanking::rank(Population< Key >& pop, unsigned pe) {
+
+    const unsigned p = pop.p;
+    std::vector< std::pair< double, unsigned > >& fitness = pop.fitness;
+    if(pe > p) { pe = p; }
+
+    pop.sortFitness();
+
+    frontOf.resize(p);
+    fitnessOf.resize(p);
+    lastRelocations.clear();
+    for(unsigned f = 0; f < fronts.size(); ++f) { fronts[f].clear(); }
+
+    for(unsigned i = 0; i < p; ++i) {
+        fitnessOf[fitness[i].second] = fitness[i].first;
+
+        unsigned f;
+        if(i > 0 && fitness[i-1].first == fitness[i].first) {
+            f = frontOf[i-1];    // a copy is dominated by exactly the same chromosomes
+        }
+        else {
+            // the first front whose last member does not dominate this chromosome
+            const int relocations = decode(fitness[i].first).second;
+            f = std::upper_bound(lastRelocations.begin(), lastRelocations.end(), relocations) - lastRelocations.begin();
+            if(f == lastRelocations.size()) { lastRelocations.push_back(relocations); }
+            else { lastRelocations[f] = relocations; }
+        }
+        if(f == fronts.size()) { fronts.push_back(std::vector< unsigned >()); }
+        fronts[f].push_back(i);
+        frontOf[i] = f;
+    }
+
+    frontSize = fronts[0].size();
+
+    crowded.clear();
+    for(unsigned f = 0; crowded.size() < pe; ++f) {
+        const std::vector< unsigned >& front = fronts[f];
+        const unsigned m = front.size();
+
+        crowded.push_back(std::make_pair(double(f), fitness[front[0]].second));
+        if(m > 1) { crowded.push_back(std::make_pair(double(f), fitness[front[m-1]].second)); }
+
+        // members are sorted by increasing distance, hence by non-increasing relocations
+        const std::pair< int, int > first = decode(fitness[front[0]].first);
+        const std::pair< int, int > last = decode(fitness[front[m-1]].first);
+        const double distanceRange = last.first - first.first;
+        const double relocationRange = first.second - last.second;
+        for(unsigned j = 1; j + 1 < m; ++j) {
+            const std::pair< int, int > previous = decode(fitness[front[j-1]].first);
+            const std::pair< int, int > next = decode(fitness[front[j+1]].first);
+            double crowding = 0.0;
+            if(distanceRange > 0) { crowding += (next.first - previous.first) / distanceRange; }
+            if(relocationRange > 0) { crowding += (previous.second - next.second) / relocationRange; }
+            crowded.push_back(std::make_pair(f + 0.5 / (1.0 + crowding), fitness[front[j]].second));
+        }
+    }
+
+    std::nth_element(crowded.begin(), crowded.begin() + pe, crowded.end());
+    std::sort(crowded.begin(), crowded.begin() + pe);
+
+    // The elite in that order, then the others as they are
+    isElite.assign(p, false);
+    ranking.clear();
+    for(unsigned i = 0; i < pe; ++i) {
+        const unsigned slot = crowded[i].second;
+        ranking.push_back(std::make_pair(fitnessOf[slot], slot));
+        isElite[slot] = true;
+    }
+    for(unsigned i = 0; i < p; ++i) {
+        if(!isElite[fitness[i].second]) { ranking.push_back(fitness[i]); }
+    }
+
+    fitness.swap(ranking);
+    pop.ranked = pe;
+    pop.orderValid = false;
+}
+
+/*
+ * Decoder of the BRKGA of MOBRKGA: the fitness of a chromosome is its objectives, as encoded by
+ * ParetoRanking. Any offspring may join the first front, so the cutoff is ignored.
+ */
+template< class Decoder >
+class ObjectiveDecoder {
+public:
+    ObjectiveDecoder(Decoder& _decoder, const ParetoRanking& _coding) : decoder(_decoder), coding(_coding) {}
+
+    template< class Chromosome >
+    double decode(const Chromosome& chromosome, unsigned threadId = 0, double = INF) {
+        return coding.encode(decoder.decodeObjectives(chromosome, threadId));
+    }
+
+    template< class Key >
+    void decodeBatch(const std::vector< Span< const Key > >& block, std::vector< double >& fitness, unsigned threadId = 0, double = INF) {
+        fitness.resize(block.size());
+        for(unsigned i = 0; i < block.size(); ++i) { fitness[i] = decode(block[i], threadId); }
+    }
+
+private:
+    Decoder& decoder;
+    const ParetoRanking coding;
+};
+
+template< class Decoder, class RNG, class Key = double >
+class MOBRKGA {
+public:
+    /*
+     * Same parameters as BRKGA, with a single population
+     */
+    MOBRKGA(unsigned n, unsigned p, double pe, double pm, double rhoe, Decoder& refDecoder, RNG& refRNG, unsigned MAX_THREADS = 1, bool hugePages = false);
+
+    /**
+     * Resets the population with brand new keys
+     */
+    void reset();
+
+    /**
+     * Evolve the current population for the given number of generations
+     */
+    void evolve(unsigned generations = 1);
+
+    /**
+     * Returns the current population: its elite is ranked, and the other chromosomes follow by
+     * increasing objectives
+     */
+    const Population< Key >& getPopulation() const;
+
+    /**
+     * Returns the objectives (distance, relocations) of the i-th ranked chromosome
+     */
+    std::pair< int, int > getObjectives(unsigned i) const;
+
+    /**
+     * Returns the number of chromosomes in the first front of the current population
+     */
+    unsigned getFrontSize() const;
+
+    // Return copies to the internal parameters:
+    unsigned getN() const;
+    unsigned getP() const;
+    unsigned getPe() const;
+    unsigned getPm() const;
+    double getRhoe() const;
+    unsigned getMAX_THREADS() const;
+
+private:
+
+    // Each of the 2n loading steps relocates at most l items:
+    static unsigned relocationStride();
+
+    ObjectiveDecoder< Decoder > objectiveDecoder;                               // decoder of 'algorithm'
+    BRKGA< ObjectiveDecoder< Decoder >, RNG, Key, ParetoRanking > algorithm;    // with a single population
+};
+
+template< class Decoder, class RNG, class Key >
+MOBRKGA< Decoder, RNG, Key >::MOBRKGA(unsigned n, unsigned p, double pe, double pm, double rhoe,
+        Decoder& decoder, RNG& rng, unsigned MAX, bool hugePages) :
+        objectiveDecoder(decoder, ParetoRanking(relocationStride())),
+        algorithm(n, p, pe, pm, rhoe, objectiveDecoder, rng, 1, MAX, hugePages, ParetoRanking(relocationStride())) {
+}
+
+template< class Decoder, class RNG, class Key >
+inline unsigned MOBRKGA< Decoder, RNG, Key >::relocationStride() {
+    return 2 * Data::getInstance().numItems * Data::getInstance().reloadingDepth + 1;
+}
+
+template< class Decoder, class RNG, class Key >
+const Population< Key >& MOBRKGA< Decoder, RNG, Key >::getPopulation() const {
+    return algorithm.getPopulation();
+}
+
+template< class Decoder, class RNG, class Key >
+std::pair< int, int > MOBRKGA< Decoder, RNG, Key >::getObjectives(unsigned i) const {
+    return algorithm.getRanking().decode(algorithm.getPopulation().getFitness(i));
+}
+
+template< class Decoder, class RNG, class Key >
+unsigned MOBRKGA< Decoder, RNG, Key >::getFrontSize() const {
+    return algorithm.getRanking().getFrontSize();
+}
+
+template< class Decoder, class RNG, class Key >
+void MOBRKGA< Decoder, RNG, Key >::reset() {
+    algorithm.reset();
+}
+
+template< class Decoder, class RNG, class Key >
+void MOBRKGA< Decoder, RNG, Key >::evolve(unsigned generations) {
+    algorithm.evolve(generations);
+}
+
+template< class Decoder, class RNG, class Key >
+unsigned MOBRKGA< Decoder, RNG, Key >::getN() const { return algorithm.getN(); }
+
+template< class Decoder, class RNG, class Key >
+unsigned MOBRKGA< Decoder, RNG, Key >::getP() const { return algorithm.getP(); }
+
+template< class Decoder, class RNG, class Key >
+unsigned MOBRKGA< Decoder, RNG, Key >::getPe() const { return algorithm.getPe(); }
+
+template< class Decoder, class RNG, class Key >
+unsigned MOBRKGA< Decoder, RNG, Key >::getPm() const { return algorithm.getPm(); }
+
+template< class Decoder, class RNG, class Key >
+double MOBRKGA< Decoder, RNG, Key >::getRhoe() const { return algorithm.getRhoe(); }
+
+template< class Decoder, class RNG, class Key >
+unsigned MOBRKGA< Decoder, RNG, Key >::getMAX_THREADS() const { return algorithm.getMAX_THREADS(); }
+
+#endif
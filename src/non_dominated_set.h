@@ -2,79 +2,159 @@
 #define NON_DOMINATED_SET_H
 
 #include <iostream>
+#include <iomanip>
 #include <fstream>
-#include <list>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <mutex>
 
 using namespace std;
 
+// Pareto front of points (f1, f2), both minimized. Kept as a staircase in one sorted vector: f1
+// strictly increasing and f2 strictly decreasing, so among the points with f1 <= x the last one has
+// the smallest f2, and a point is dominated (or already present) iff that one has f2 <= its own.
+// Rejections, by far the most frequent outcome, thus take a single binary search.
+
 class NonDominatedSet {
 
     private:
-        
-            list < pair < int, int > > allNDS;
+
+            vector < pair < int, int > > front;
+            vector < pair < int, int > > sortedBatch, merged;    // scratch space of add(batch)
 
     public:
-        
+
             NonDominatedSet() {};
-            
-            int getRelation(pair < int, int > a, pair < int, int > b) {
-                
-                int val = 0;
-            
-                if (a.first < b.first) {
-                    if (val == -1) return 0;
-                    val = 1;
-                } else if (a.first > b.first) {
-                    if (val == 1) return 0;
-                    val = -1;
-                }
-                
-                if (a.second < b.second) {
-                    if (val == -1) return 0;
-                    val = 1;
-                } else if (a.second > b.second) {
-                    if (val == 1) return 0;
-                    val = -1;
-                }
 
-                return val;
+            // 1 if a dominates b, -1 if b dominates a, 0 otherwise (including a == b)
+            int getRelation(pair < int, int > a, pair < int, int > b) {
+                if(a == b) return 0;
+                if(a.first <= b.first && a.second <= b.second) return 1;
+                if(b.first <= a.first && b.second <= a.second) return -1;
+                return 0;
             }
-            
-            void add(pair < int, int > s) {
 
-                bool isAdded = true;
+            // Returns whether s entered the set, i.e., it is neither dominated by nor equal to a member
+            bool add(pair < int, int > s) {
+
+                vector < pair < int, int > > :: iterator it = upper_bound(front.begin(), front.end(), make_pair(s.first, INT_MAX));
+                if(it != front.begin() && (it - 1)->second <= s.second) return false;
 
-                list < pair < int, int > > :: iterator it = allNDS.begin();
-                
-                for(; it != allNDS.end(); ++it) {
-                    
-                    pair < int, int > other = *it;
+                // the members s dominates follow it contiguously: f1 >= s.f1 and f2 >= s.f2
+                vector < pair < int, int > > :: iterator first = lower_bound(front.begin(), it, s);
+                vector < pair < int, int > > :: iterator last = first;
+                while(last != front.end() && last->second >= s.second) ++last;
+
+                if(first == last) front.insert(first, s);
+                else {
+                    *first = s;
+                    front.erase(first + 1, last);
+                }
+                return true;
+            }
 
-                    int rel = getRelation(s, other);
+            // Batch insertion: one sort of the batch and one linear merge with the front
+            void add(const vector < pair < int, int > > &batch) {
 
-                    // if dominated by or equal in design space
-                    if (rel == -1 || (rel == 0 && s == other)) {
-                        isAdded = false;
-                        break;
-                    } else if (rel == 1) it = allNDS.erase(it);
+                sortedBatch.assign(batch.begin(), batch.end());
+                sort(sortedBatch.begin(), sortedBatch.end());
+                merged.resize(front.size() + sortedBatch.size());
+                std::merge(front.begin(), front.end(), sortedBatch.begin(), sortedBatch.end(), merged.begin());
 
+                front.clear();
+                for(int i = 0; i < (int)merged.size(); ++i) {
+                    if(front.empty() || merged[i].second < front.back().second) front.push_back(merged[i]);
                 }
+            }
 
-                if (isAdded) allNDS.push_back(s);
+            // Adds every solution of other to this set and leaves other empty
+            void merge(NonDominatedSet &other) {
+                add(other.front);
+                other.front.clear();
             }
 
-            void saveSet(const string outputFileName) { 
-                
+            int size() const { return front.size(); }
+
+            const vector < pair < int, int > >& getPoints() const { return front; }
+
+            void clear() { front.clear(); }
+
+            void saveSet(const string outputFileName) {
+
                 ofstream fout(outputFileName.c_str());
-                allNDS.sort();
                 fout << fixed << setw(10) << "F1" << ' ' << fixed << setw(10) << "F2" << endl;
-                list < pair < int, int > > :: iterator it = allNDS.begin();                
-                for(; it != allNDS.end(); ++it) {
-                    fout << fixed << setw(10) << it->first << ' ' << setw(10) << it->second << endl;
+                for(int i = 0; i < (int)front.size(); ++i) {
+                    fout << fixed << setw(10) << front[i].first << ' ' << setw(10) << front[i].second << endl;
                 }
                 fout.close();
             }
 };
 
-#endif
+// NonDominatedSet that many threads may add to at once. Points are first checked against a private
+// copy of the front, refreshed from the shared one only when its version changes, so the frequent
+// rejections of dominated points take no lock; the rare insertions are serialized by a mutex.
+
+class ConcurrentNonDominatedSet {
+
+    private:
 
+            NonDominatedSet shared;
+            mutable mutex lock;
+            atomic < unsigned long > version;
+
+    public:
+
+            // Per-thread view of the set; every thread must use its own
+            class Handle {
+
+                private:
+
+                        ConcurrentNonDominatedSet *owner;
+                        NonDominatedSet snapshot;
+                        unsigned long snapshotVersion;
+
+                public:
+
+                        Handle(ConcurrentNonDominatedSet &_owner) : owner(&_owner), snapshotVersion(~0UL) {}
+
+                        bool add(pair < int, int > s) {
+                            unsigned long current = owner->version.load(memory_order_acquire);
+                            if(current != snapshotVersion) {
+                                lock_guard < mutex > guard(owner->lock);
+                                snapshot = owner->shared;
+                                snapshotVersion = owner->version.load(memory_order_relaxed);
+                            }
+                            // the shared front only ever dominates the snapshot, so a rejection is final
+                            if(!snapshot.add(s)) return false;
+                            return owner->add(s);
+                        }
+            };
+
+            ConcurrentNonDominatedSet() : version(0) {}
+
+            ConcurrentNonDominatedSet(ConcurrentNonDominatedSet const&)  = delete;
+            void operator=(ConcurrentNonDominatedSet const&)             = delete;
+
+            bool add(pair < int, int > s) {
+                lock_guard < mutex > guard(lock);
+                if(!shared.add(s)) return false;
+                version.fetch_add(1, memory_order_release);
+                return true;
+            }
+
+            void add(const vector < pair < int, int > > &batch) {
+                lock_guard < mutex > guard(lock);
+                shared.add(batch);
+                version.fetch_add(1, memory_order_release);
+            }
+
+            // Copy of the current front
+            NonDominatedSet getSet() const {
+                lock_guard < mutex > guard(lock);
+                return shared;
+            }
+};
+
+#endif
@@ -9,6 +9,11 @@ def launcher(_approach, _area, _total_of_items, _reloading_depth, _relocation_co
     _reloading_depth = int(_total_of_items) if _reloading_depth == 'n' else _reloading_depth
     os.system("./dtsppl --approach %s --pickuparea ../instances/%sp.tsp --deliveryarea ../instances/%sd.tsp --n %02d --l %02d --h %02d --outputsolution ../solutions/%s/%s_%02d_%02d_%02d" % (_approach, _area, _area, _total_of_items, _reloading_depth, _relocation_cost, _approach, _area, _total_of_items, _reloading_depth, _relocation_cost))
 
+# a single BRKGA run answers every relocation cost, and writes the same files as one run per cost
+def multi_cost_launcher(_approach, _area, _total_of_items, _reloading_depth, _relocation_costs):
+    _reloading_depth = int(_total_of_items) if _reloading_depth == 'n' else _reloading_depth
+    os.system("./dtsppl --approach %s --pickuparea ../instances/%sp.tsp --deliveryarea ../instances/%sd.tsp --n %02d --l %02d --h %s --outputsolution ../solutions/%s/%s_%02d_%02d" % (_approach, _area, _area, _total_of_items, _reloading_depth, ",".join(str(h) for h in _relocation_costs), _approach, _area, _total_of_items, _reloading_depth))
+
 if __name__ == "__main__":
 
     approach = ["ILP1", "ILP2", "BRKGA", ]
@@ -24,7 +29,12 @@ if __name__ == "__main__":
 
     for _product in itertools.product(approach, total_of_items, area, reloading_depth, relocation_cost):
         _approach, _total_of_items, _area, _reloading_depth, _relocation_cost = _product
+        if _approach == "BRKGA": continue
         pool.apply_async(launcher, args=(_approach, _area, _total_of_items, _reloading_depth, _relocation_cost))
+
+    for _product in itertools.product(["BRKGA"] if "BRKGA" in approach else [], total_of_items, area, reloading_depth):
+        _approach, _total_of_items, _area, _reloading_depth = _product
+        pool.apply_async(multi_cost_launcher, args=(_approach, _area, _total_of_items, _reloading_depth, relocation_cost))
         
     pool.close()
     pool.join()
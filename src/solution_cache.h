@@ -0,0 +1,73 @@
+#ifndef SOLUTION_CACHE_H
+#define SOLUTION_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+using namespace std;
+
+// Bounded hash table from the hash of a decoded solution to its (distance, relocations), shared by
+// every decoding thread without locks. It is direct-mapped: a new solution overwrites whatever was
+// in its slot. Each slot keeps (hash ^ value, value), so a slot torn by concurrent writers fails the
+// check on lookup and is reported as a miss instead of returning another solution's cost.
+
+class SolutionCache {
+
+    private:
+
+            struct Entry {
+                std::atomic < uint64_t > check;    // hash ^ value
+                std::atomic < uint64_t > value;    // valid bit | distance | relocations
+            };
+
+            static const uint64_t VALID = 1ULL << 63;
+
+            unique_ptr < Entry[] > entries;
+            uint64_t mask;
+            bool isEnabled;
+
+    public:
+
+            // capacity is rounded up to a power of two; 0 disables the cache
+            SolutionCache(uint64_t capacity = 0) {
+                isEnabled = capacity > 0;
+                uint64_t size = 1;
+                while(size < capacity) size <<= 1;
+                mask = size - 1;
+                entries.reset(new Entry[isEnabled ? size : 0]);
+                clear();
+            }
+
+            SolutionCache(SolutionCache const&)  = delete;
+            void operator=(SolutionCache const&) = delete;
+
+            bool enabled() const { return isEnabled; }
+
+            // Forgets every solution; not safe while other threads use the cache
+            void clear() {
+                for(uint64_t i = 0; isEnabled && i <= mask; ++i) {
+                    entries[i].check.store(0, memory_order_relaxed);
+                    entries[i].value.store(0, memory_order_relaxed);
+                }
+            }
+
+            bool lookup(uint64_t hash, int &distance, int &numberOfRelocations) const {
+                const Entry &e = entries[hash & mask];
+                const uint64_t value = e.value.load(memory_order_relaxed);
+                const uint64_t check = e.check.load(memory_order_relaxed);
+                if(!(value & VALID) || (check ^ value) != hash) return false;
+                distance = (int)((value >> 32) & 0x7fffffff);
+                numberOfRelocations = (int)(uint32_t)value;
+                return true;
+            }
+
+            void insert(uint64_t hash, int distance, int numberOfRelocations) {
+                Entry &e = entries[hash & mask];
+                const uint64_t value = VALID | ((uint64_t)distance << 32) | (uint32_t)numberOfRelocations;
+                e.value.store(value, memory_order_relaxed);
+                e.check.store(hash ^ value, memory_order_relaxed);
+            }
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef SOLUTION_EXCHANGE_H
+#define SOLUTION_EXCHANGE_H
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <ostream>
+
+#include "data.h"
+#include "loading_plan.h"
+
+using namespace std;
+
+// Incumbents shared by the two searches of a HYBRID run, the MIP of an ILP formulation and a BRKGA,
+// each on its own thread. Either one posts the plans it finds and takes those of the other. A post
+// is kept only if it is better than every plan posted so far, so both sides only ever receive an
+// improvement, which for the MIP is also a tighter cutoff. The MIP also posts its lower bound, and
+// the search is over once a plan reaches it. Plans are compared on the ILP's cost (see
+// RelocationCounting), the only one both sides can agree on.
+
+class SolutionExchange {
+
+    private:
+
+            mutex lock;
+            LoadingPlan best;
+            int bestCost;
+            int lowerBound;
+            bool pendingForILP, pendingForBRKGA;
+            atomic < bool > finished;
+
+            // accepted posts and takes, per side
+            int postedByILP, postedByBRKGA, takenByILP, takenByBRKGA;
+
+            bool post(const LoadingPlan &plan, bool &pendingForOther, int &posted) {
+                const int cost = plan.distance + Data::getInstance().costForEachRealoading * plan.relocations;
+                lock_guard < mutex > guard(lock);
+                if(cost >= bestCost) return false;
+                best = plan;
+                bestCost = cost;
+                pendingForOther = true;
+                ++posted;
+                return true;
+            }
+
+            bool take(LoadingPlan &plan, bool &pending, int &taken) {
+                lock_guard < mutex > guard(lock);
+                if(!pending) return false;
+                plan = best;
+                pending = false;
+                ++taken;
+                return true;
+            }
+
+    public:
+
+            SolutionExchange() : bestCost(INF), lowerBound(0), pendingForILP(false), pendingForBRKGA(false), finished(false), postedByILP(0), postedByBRKGA(0), takenByILP(0), takenByBRKGA(0) {}
+
+            // Both return whether the plan, whose relocations are counted as the ILP does, is the
+            // new best one
+            bool postFromILP(const LoadingPlan &plan) { return post(plan, pendingForBRKGA, postedByILP); }
+            bool postFromBRKGA(const LoadingPlan &plan) { return post(plan, pendingForILP, postedByBRKGA); }
+
+            // Both return whether the other side posted a plan since the last take, and if so
+            // write the best one to plan
+            bool takeForILP(LoadingPlan &plan) { return take(plan, pendingForILP, takenByILP); }
+            bool takeForBRKGA(LoadingPlan &plan) { return take(plan, pendingForBRKGA, takenByBRKGA); }
+
+            int getBestCost() {
+                lock_guard < mutex > guard(lock);
+                return bestCost;
+            }
+
+            void postBound(int bound) {
+                lock_guard < mutex > guard(lock);
+                lowerBound = max(lowerBound, bound);
+            }
+
+            // Called once the MIP is over, which ends the BRKGA too
+            void finish() { finished = true; }
+
+            // Whether the MIP is over or the best plan is proven optimal
+            bool isFinished() {
+                if(finished) return true;
+                lock_guard < mutex > guard(lock);
+                return bestCost <= lowerBound;
+            }
+
+            void saveStatistics(ostream &out) {
+                lock_guard < mutex > guard(lock);
+                out << "exchange: " << postedByILP << " MIP incumbents (" << takenByBRKGA << " taken by the BRKGA), "
+                    << postedByBRKGA << " BRKGA incumbents (" << takenByILP << " taken by the MIP), best " << bestCost << ", bound " << lowerBound << endl;
+            }
+};
+
+#endif
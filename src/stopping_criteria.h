@@ -0,0 +1,152 @@
+#ifndef STOPPING_CRITERIA_H
+#define STOPPING_CRITERIA_H
+
+#include <algorithm>
+#include <vector>
+
+#include "data.h"
+
+using namespace std;
+
+// Progress of one run, updated by the caller after every generation. A run may optimize several
+// costs at once (e.g., one per relocation cost): it improves when any of them does, and bestCost is
+// the worst of them, so a target is only reached once every cost reaches it.
+
+class SearchStatus {
+
+    public:
+
+            double elapsedTime;
+            int generation;
+            int generationsWithoutImprovement;
+            double bestCost;
+            vector < double > bestCosts;
+
+            SearchStatus(double initialBestCost) {
+                init(vector < double > (1, initialBestCost));
+            }
+
+            SearchStatus(const vector < double > &initialBestCosts) {
+                init(initialBestCosts);
+            }
+
+            void update(double currentBestCost) {
+                update(vector < double > (1, currentBestCost));
+            }
+
+            // generations is the number of generations since the previous update
+            void update(const vector < double > &currentBestCosts, int generations = 1) {
+                generation += generations;
+                bool improved = false;
+                for(int i = 0; i < (int)bestCosts.size(); ++i) {
+                    if(currentBestCosts[i] < bestCosts[i] - EPS) {
+                        bestCosts[i] = currentBestCosts[i];
+                        improved = true;
+                    }
+                }
+                bestCost = *max_element(bestCosts.begin(), bestCosts.end());
+                if(improved) generationsWithoutImprovement = 0;
+                else generationsWithoutImprovement += generations;
+            }
+
+    private:
+
+            void init(const vector < double > &initialBestCosts) {
+                elapsedTime = 0.0;
+                generation = 0;
+                generationsWithoutImprovement = 0;
+                bestCosts = initialBestCosts;
+                bestCost = *max_element(bestCosts.begin(), bestCosts.end());
+            }
+};
+
+class StoppingCriterion {
+
+    public:
+
+            virtual ~StoppingCriterion() {}
+            virtual bool isSatisfied(const SearchStatus &status) const = 0;
+};
+
+class TimeLimitCriterion: public StoppingCriterion {
+
+    private:
+
+            double timeLimit;
+
+    public:
+
+            TimeLimitCriterion(double _timeLimit) : timeLimit(_timeLimit) {}
+
+            bool isSatisfied(const SearchStatus &status) const {
+                return status.elapsedTime >= timeLimit;
+            }
+};
+
+class StagnationCriterion: public StoppingCriterion {
+
+    private:
+
+            int maxGenerationsWithoutImprovement;
+
+    public:
+
+            StagnationCriterion(int _maxGenerationsWithoutImprovement) : maxGenerationsWithoutImprovement(_maxGenerationsWithoutImprovement) {}
+
+            bool isSatisfied(const SearchStatus &status) const {
+                return status.generationsWithoutImprovement >= maxGenerationsWithoutImprovement;
+            }
+};
+
+// Stops as soon as a solution at least as good as targetCost is known. Used both for a
+// user-given target and for a proven lower bound, which makes the best solution optimal.
+
+class TargetCostCriterion: public StoppingCriterion {
+
+    private:
+
+            double targetCost;
+
+    public:
+
+            TargetCostCriterion(double _targetCost) : targetCost(_targetCost) {}
+
+            bool isSatisfied(const SearchStatus &status) const {
+                return status.bestCost <= targetCost + EPS;
+            }
+};
+
+// Stops a run when any of its criteria is satisfied. Criteria hold no per-run state, so one
+// object can serve several concurrent runs, each with its own SearchStatus.
+
+class StoppingCriteria {
+
+    private:
+
+            vector < StoppingCriterion* > criteria;
+
+    public:
+
+            StoppingCriteria() {}
+
+            StoppingCriteria(StoppingCriteria const&)  = delete;
+            void operator=(StoppingCriteria const&)    = delete;
+
+            ~StoppingCriteria() {
+                for(int i = 0; i < (int)criteria.size(); ++i) delete criteria[i];
+            }
+
+            // Takes ownership of criterion
+            void add(StoppingCriterion *criterion) {
+                criteria.push_back(criterion);
+            }
+
+            bool isSatisfied(const SearchStatus &status) const {
+                for(int i = 0; i < (int)criteria.size(); ++i) {
+                    if(criteria[i]->isSatisfied(status)) return true;
+                }
+                return false;
+            }
+};
+
+#endif
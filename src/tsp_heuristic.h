@@ -0,0 +1,205 @@
+#ifndef TSP_HEURISTIC_H
+#define TSP_HEURISTIC_H
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Heuristic for the symmetric TSP that needs no solver: greedy edge construction followed by an
+// iterated local search, in which 2-opt and Or-opt descents alternate with double-bridge kicks.
+// The tour is returned as in TSPSolver::solve, i.e., it starts and ends at node 0. Results are
+// cached per distance matrix, since the same tour is requested at every BRKGA initialization.
+
+class TSPHeuristic {
+
+    private:
+
+            int maxKicks;
+
+            static mutex& cacheMutex() {
+                static mutex instance;
+                return instance;
+            }
+
+            static map < vector < int >, pair < int, vector < int > > >& cache() {
+                static map < vector < int >, pair < int, vector < int > > > instance;
+                return instance;
+            }
+
+            static int tourCost(const vector < int > &tour, const vector < vector < int > > &distance) {
+                int cost = 0;
+                for(int i = 0; i < (int)tour.size(); ++i) {
+                    cost += distance[tour[i]][tour[(i+1) % tour.size()]];
+                }
+                return cost;
+            }
+
+            static int findRoot(vector < int > &parent, int u) {
+                while(parent[u] != u) u = parent[u] = parent[parent[u]];
+                return u;
+            }
+
+            // Repeatedly adds the shortest edge that keeps every degree at most 2 and closes no cycle
+            static vector < int > greedyTour(int n, const vector < vector < int > > &distance) {
+
+                vector < pair < int, pair < int, int > > > edges;
+                for(int i = 0; i < n; ++i) {
+                    for(int j = i+1; j < n; ++j) edges.push_back(make_pair(distance[i][j], make_pair(i, j)));
+                }
+                sort(edges.begin(), edges.end());
+
+                vector < int > degree(n, 0), parent(n);
+                vector < vector < int > > adjacent(n);
+                for(int i = 0; i < n; ++i) parent[i] = i;
+
+                int numEdges = 0;
+                for(int e = 0; e < (int)edges.size() && numEdges < n-1; ++e) {
+                    int u = edges[e].second.first, v = edges[e].second.second;
+                    if(degree[u] == 2 || degree[v] == 2 || findRoot(parent, u) == findRoot(parent, v)) continue;
+                    parent[findRoot(parent, u)] = findRoot(parent, v);
+                    adjacent[u].push_back(v);
+                    adjacent[v].push_back(u);
+                    degree[u] += 1;
+                    degree[v] += 1;
+                    numEdges += 1;
+                }
+
+                // walk the Hamiltonian path from one of its ends
+                int start = 0;
+                while(degree[start] == 2) start += 1;
+
+                vector < int > tour;
+                int previous = -1, node = start;
+                while(node != -1) {
+                    tour.push_back(node);
+                    int next = -1;
+                    for(int k = 0; k < (int)adjacent[node].size(); ++k) {
+                        if(adjacent[node][k] != previous) next = adjacent[node][k];
+                    }
+                    previous = node;
+                    node = next;
+                }
+                return tour;
+            }
+
+            // Applies the first improving 2-opt move found; returns false at a local optimum
+            static bool improveTwoOpt(vector < int > &tour, const vector < vector < int > > &distance) {
+
+                const int n = tour.size();
+                for(int i = 0; i < n-2; ++i) {
+                    for(int j = i+2; j < n; ++j) {
+                        if(i == 0 && j == n-1) continue;
+                        int a = tour[i], b = tour[i+1], c = tour[j], d = tour[(j+1) % n];
+                        if(distance[a][c] + distance[b][d] < distance[a][b] + distance[c][d]) {
+                            reverse(tour.begin() + i + 1, tour.begin() + j + 1);
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            }
+
+            // Applies the first improving move of a segment of 1 to 3 nodes to another position of
+            // the tour, possibly reversed; returns false at a local optimum
+            static bool improveOrOpt(vector < int > &tour, const vector < vector < int > > &distance) {
+
+                const int n = tour.size();
+                for(int length = 1; length <= 3 && length < n-2; ++length) {
+                    for(int i = 0; i + length <= n; ++i) {
+
+                        int first = tour[i], last = tour[i+length-1];
+                        int prev = tour[(i-1+n) % n], next = tour[(i+length) % n];
+                        int removalGain = distance[prev][first] + distance[last][next] - distance[prev][next];
+
+                        for(int j = 0; j < n; ++j) {
+                            // the insertion edge (tour[j], tour[j+1]) must lie outside the segment and its neighbouring edges
+                            if((j >= i-1 && j <= i+length-1) || (i == 0 && j == n-1)) continue;
+                            int x = tour[j], y = tour[(j+1) % n];
+                            int forward = distance[x][first] + distance[last][y] - distance[x][y];
+                            int backward = distance[x][last] + distance[first][y] - distance[x][y];
+                            if(min(forward, backward) >= removalGain) continue;
+
+                            vector < int > segment(tour.begin() + i, tour.begin() + i + length);
+                            if(backward < forward) reverse(segment.begin(), segment.end());
+
+                            vector < int > rest;
+                            for(int k = 0; k < n; ++k) {
+                                if(k < i || k >= i + length) rest.push_back(tour[k]);
+                            }
+                            int at = find(rest.begin(), rest.end(), x) - rest.begin();
+                            rest.insert(rest.begin() + at + 1, segment.begin(), segment.end());
+                            tour = rest;
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            }
+
+            static void localSearch(vector < int > &tour, const vector < vector < int > > &distance) {
+                while(improveTwoOpt(tour, distance) || improveOrOpt(tour, distance)) {}
+            }
+
+            // Reconnects four segments A B C D of the tour as A C B D
+            static vector < int > doubleBridge(const vector < int > &tour, mt19937 &rng) {
+
+                const int n = tour.size();
+                int cut[3];
+                for(int k = 0; k < 3; ++k) cut[k] = 1 + rng() % (n-1);
+                sort(cut, cut + 3);
+
+                vector < int > kicked(tour.begin(), tour.begin() + cut[0]);
+                kicked.insert(kicked.end(), tour.begin() + cut[1], tour.begin() + cut[2]);
+                kicked.insert(kicked.end(), tour.begin() + cut[0], tour.begin() + cut[1]);
+                kicked.insert(kicked.end(), tour.begin() + cut[2], tour.end());
+                return kicked;
+            }
+
+    public:
+
+            TSPHeuristic(int _maxKicks = 100) : maxKicks(_maxKicks) {}
+
+            pair < int, vector < int > > solve(int n, const vector < vector < int > > &distance) {
+
+                vector < int > key(1, maxKicks);
+                for(int i = 0; i < n; ++i) key.insert(key.end(), distance[i].begin(), distance[i].begin() + n);
+
+                {
+                    lock_guard < mutex > lock(cacheMutex());
+                    map < vector < int >, pair < int, vector < int > > >::iterator it = cache().find(key);
+                    if(it != cache().end()) return it->second;
+                }
+
+                vector < int > bestTour = greedyTour(n, distance);
+                localSearch(bestTour, distance);
+                int bestTourCost = tourCost(bestTour, distance);
+
+                mt19937 rng(n);
+                for(int kick = 0; n >= 8 && kick < maxKicks; ++kick) {
+                    vector < int > tour = doubleBridge(bestTour, rng);
+                    localSearch(tour, distance);
+                    int cost = tourCost(tour, distance);
+                    if(cost < bestTourCost) {
+                        bestTour = tour;
+                        bestTourCost = cost;
+                    }
+                }
+
+                // same layout as TSPSolver: from node 0, with the smaller neighbour of 0 first, back to 0
+                rotate(bestTour.begin(), find(bestTour.begin(), bestTour.end(), 0), bestTour.end());
+                if(n > 2 && bestTour[1] > bestTour[n-1]) reverse(bestTour.begin() + 1, bestTour.end());
+                bestTour.push_back(0);
+
+                pair < int, vector < int > > result = make_pair(bestTourCost, bestTour);
+
+                lock_guard < mutex > lock(cacheMutex());
+                cache()[key] = result;
+                return result;
+            }
+};
+
+#endif
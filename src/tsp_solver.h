@@ -2,6 +2,7 @@
 #define TSP_SOLVER_H
 
 #include "gurobi_c++.h"
+#include "held_karp.h"
 #include <cassert>
 #include <cstdlib>
 #include <cmath>
@@ -123,10 +124,19 @@ class Subtourelim: public GRBCallback {
 
 class TSPSolver {
 
+    private:
+            int numThreads;
+
     public:
-            TSPSolver(){}
+            TSPSolver(int _numThreads = 1) : numThreads(_numThreads) {}
 
+            // Exact by dynamic programming up to HeldKarpSolver::MAX_NODES nodes, by Gurobi above
             pair < int, vector < int > > solve(int n, const vector < vector < int > > &distance) {
+                if(n <= HeldKarpSolver::MAX_NODES) return HeldKarpSolver(numThreads).solve(n, distance);
+                return solveWithGurobi(n, distance);
+            }
+
+            pair < int, vector < int > > solveWithGurobi(int n, const vector < vector < int > > &distance) {
                 
                 vector < int > bestTour;
                 int bestTourCost;